@@ -0,0 +1,113 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#include "control.h"
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+Control::Control( const std::string &address )
+{
+    sockaddr_in addr;
+    memset( &addr, 0, sizeof(addr) );
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+
+    unsigned port = 0;
+    char host[INET_ADDRSTRLEN] = { 0 };
+    if( sscanf( address.c_str(), "%15[0-9.]:%u", host, &port ) == 2 )
+    {
+        if( inet_pton( AF_INET, host, &addr.sin_addr ) != 1 )
+        {
+            throw std::runtime_error( "[control] bad address: " + address );
+        }
+    }
+    else if( sscanf( address.c_str(), "%u", &port ) != 1 )
+    {
+        throw std::runtime_error( "[control] bad address: " + address );
+    }
+    if( !port || port > 0xffff )
+    {
+        throw std::runtime_error( "[control] bad port: " + address );
+    }
+    addr.sin_port = htons( port );
+
+    if( (m_fd = socket( AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 )) == -1 )
+    {
+        throw std::runtime_error( std::string("[control] socket failed: ") + strerror( errno ) );
+    }
+    if( bind( m_fd, (sockaddr *)&addr, sizeof(addr) ) == -1 )
+    {
+        std::string error = strerror( errno );
+        close( m_fd );
+        throw std::runtime_error( "[control] bind failed: " + error );
+    }
+    std::cerr << "[*] control channel on udp " << inet_ntoa( addr.sin_addr ) << ":" << port << "\n";
+}
+
+Control::~Control()
+{
+    close( m_fd );
+}
+
+void Control::process( Defects &defects )
+{
+    char buf[MAX_COMMAND];
+    sockaddr_in from;
+    socklen_t len = sizeof(from);
+    ssize_t size;
+    while( (size = recvfrom( m_fd, buf, sizeof(buf), 0, (sockaddr *)&from, &len )) >= 0 )
+    {
+        std::string command( buf, size );
+        while( !command.empty() && (command.back() == '\n' || command.back() == '\r' || command.back() == ' ') )
+        {
+            command.pop_back();
+        }
+        std::string reply = f_execute( command, defects ) + "\n";
+        std::cerr << "[*] control: " << command << " -> " << reply;
+        (void)!sendto( m_fd, reply.data(), reply.size(), MSG_DONTWAIT, (sockaddr *)&from, len );
+        len = sizeof(from);
+    }
+}
+
+std::string Control::f_execute( const std::string &command, Defects &defects )
+{
+    size_t space = command.find( ' ' );
+    std::string verb = command.substr( 0, space );
+    std::string arg = space == std::string::npos ? std::string() : command.substr( space + 1 );
+
+    if( verb == "test" )
+    {
+        if( !defects.start( arg ) )
+        {
+            return "error unknown test: " + arg;
+        }
+    }
+    else if( verb == "alpha" )
+    {
+        char *end = nullptr;
+        float alpha = strtof( arg.c_str(), &end );
+        // nan would pass the clamping of set_alpha() untouched
+        if( arg.empty() || *end || !std::isfinite( alpha ) )
+        {
+            return "error bad value: " + arg;
+        }
+        if( !defects.set_alpha( alpha ) )
+        {
+            return "error the current test has no parameter";
+        }
+    }
+    else if( verb != "status" )
+    {
+        return "error unknown command: " + verb;
+    }
+    return "ok " + defects.state();
+}
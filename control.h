@@ -0,0 +1,45 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#ifndef VIDEODEFECTS_CONTROL_H
+#define VIDEODEFECTS_CONTROL_H
+
+#include "defects.h"
+#include <netinet/in.h>
+#include <string>
+
+// Defect control without a window: one text command per UDP datagram, every command is
+// answered with "ok <state>" or "error <reason>" to its sender.
+//     test <name>     start a test by its name in the list ("test noise", "test low chroma")
+//     test off        stop the current test
+//     alpha <value>   the parameter of the current test (the left/right keys)
+//     status          the current test, its parameter and result
+// Bound to the loopback interface unless an address is given: anyone who can reach the
+// port controls the stream.
+class Control {
+public:
+    static const size_t MAX_COMMAND = 256;
+
+    // [address:]port
+    explicit Control( const std::string &address );
+    Control( const Control& orig ) = delete;
+    Control &operator =( const Control& orig ) = delete;
+    ~Control();
+
+    int fd() const
+    {
+        return m_fd;
+    }
+    // applies all the pending commands, never blocks
+    void process( Defects &defects );
+
+private:
+    int m_fd;
+
+private:
+    std::string f_execute( const std::string &command, Defects &defects );
+};
+
+
+#endif //VIDEODEFECTS_CONTROL_H
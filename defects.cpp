@@ -7,6 +7,7 @@
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/imgproc/types_c.h>
+#include <algorithm>
 #include <iostream>
 
 namespace {
@@ -21,6 +22,32 @@ namespace {
         "  equalize"
     };
 
+    // ranges of the test parameters, min == max - the test has none
+    const float alpha_limits[Defects::Tests::Number][2] = {
+        { 0.f, 0.f },       // monochrome
+        { 1.f, 10.f },      // overexposed
+        { 0.f, 1.f },       // shadowed
+        { 0.f, 0.f },       // low chroma
+        { 0.01f, 2.f },     // atvl
+        { 1.f, 256.f },     // posterize
+        { 0.f, 256.f },     // noise
+        { 0.f, 0.f }        // equalize
+    };
+
+    // what a histogram overlay shows: the curves turned on and their heights in pixels
+    std::string histogram_key( uint32_t flags, const cv::Mat hist[3], int height )
+    {
+        std::string key( 1, char(flags >> 8) );
+        for( int k(0); k < 3; ++k )
+        {
+            for( int i(0); i < hist[k].rows; ++i )
+            {
+                key += char(std::min( cvRound( hist[k].at< float >(i) ), height ));
+            }
+        }
+        return key;
+    }
+
     uchar clip( float val, uchar min_val, uchar max_val )
     {
         return val <= min_val ? min_val : (val >= max_val ? max_val : uchar(val));
@@ -41,7 +68,11 @@ Defects::~Defects()
 
 cv::Mat Defects::convert( cv::Mat &frame )
 {
-    m_test_result.clear();
+    ++m_frame_count;
+    if( f_measure() )
+    {
+        m_test_result.clear();
+    }
 
     return f_grayscale(
                f_moveLuma(
@@ -60,18 +91,42 @@ cv::Mat Defects::convert( cv::Mat &frame )
 
 cv::Mat &Defects::testList( cv::Mat &frame )
 {
+    // the list is rasterized again only when a test is started, stopped or highlighted
+    std::string key;
     for( size_t i(0); i < Tests::Number; ++i )
     {
-        int thickness = 1 + m_test_info[i].highlighted;
-        cv::putText( frame,
-                     m_test_info[i].name.c_str(),
-                     cv::Point(10, (i + 1) * 15),
-                     cv::FONT_HERSHEY_PLAIN,
-                     1,
-                     cv::Scalar(0,0,255),
-                     thickness,
-                     false );
+        key += m_test_info[i].name + char('0' + m_test_info[i].highlighted) + '\n';
+    }
+    if( m_list_sprite.stale( key ) )
+    {
+        int baseline = 0, width = 0;
+        for( size_t i(0); i < Tests::Number; ++i )
+        {
+            width = std::max( width, cv::getTextSize( m_test_info[i].name, cv::FONT_HERSHEY_PLAIN, 1, 2, &baseline ).width );
+        }
+        m_list_sprite.reset( key, cv::Size( 10 + width + 2, (Tests::Number + 1) * 15 ) );
+        for( size_t i(0); i < Tests::Number; ++i )
+        {
+            int thickness = 1 + m_test_info[i].highlighted;
+            cv::putText( m_list_sprite.image(),
+                         m_test_info[i].name.c_str(),
+                         cv::Point(10, (i + 1) * 15),
+                         cv::FONT_HERSHEY_PLAIN,
+                         1,
+                         cv::Scalar(0,0,255),
+                         thickness,
+                         false );
+            cv::putText( m_list_sprite.alpha(),
+                         m_test_info[i].name.c_str(),
+                         cv::Point(10, (i + 1) * 15),
+                         cv::FONT_HERSHEY_PLAIN,
+                         1,
+                         cv::Scalar(255),
+                         thickness,
+                         false );
+        }
     }
+    m_list_sprite.blend( frame, cv::Point( 0, 0 ) );
     return frame;
 }
 
@@ -82,15 +137,33 @@ cv::Mat &Defects::histogram( cv::Mat &frame )
 
 cv::Mat &Defects::result( cv::Mat &frame )
 {
-    cv::putText( frame,
-                 m_test_result.c_str(),
-                 cv::Point((frame.cols - 100) / 2, 15),
-                 cv::FONT_HERSHEY_PLAIN,
-                 1,
-                 cv::Scalar(0,0,255),
-                 1,
-                 false );
-
+    if( m_test_result.empty() )
+    {
+        return frame;
+    }
+    if( m_result_sprite.stale( m_test_result ) )
+    {
+        int baseline = 0;
+        cv::Size size = cv::getTextSize( m_test_result, cv::FONT_HERSHEY_PLAIN, 1, 1, &baseline );
+        m_result_sprite.reset( m_test_result, cv::Size( size.width + 2, 15 + baseline + 2 ) );
+        cv::putText( m_result_sprite.image(),
+                     m_test_result.c_str(),
+                     cv::Point(0, 15),
+                     cv::FONT_HERSHEY_PLAIN,
+                     1,
+                     cv::Scalar(0,0,255),
+                     1,
+                     false );
+        cv::putText( m_result_sprite.alpha(),
+                     m_test_result.c_str(),
+                     cv::Point(0, 15),
+                     cv::FONT_HERSHEY_PLAIN,
+                     1,
+                     cv::Scalar(255),
+                     1,
+                     false );
+    }
+    m_result_sprite.blend( frame, cv::Point( (frame.cols - 100) / 2, 0 ) );
     return frame;
 }
 
@@ -174,29 +247,47 @@ void Defects::Right()
 
 void Defects::Enter()
 {
-    if( m_current_test != -1 )
+    f_select( m_current_test == m_highlighted ? -1 : m_highlighted );
+}
+
+bool Defects::start( const std::string &name )
+{
+    if( name == "off" )
     {
-        m_test_info[m_current_test].name[0] = ' ';
-        if( m_current_test == m_highlighted )
+        f_select( -1 );
+        return true;
+    }
+    for( int i(0); i < Tests::Number; ++i )
+    {
+        // the names are listed after the marker and a space
+        if( m_test_info[i].name.compare( 2, std::string::npos, name ) == 0 )
         {
-            m_test_flags &= ~m_test_info[m_current_test].flag;
-            m_current_test = -1;
+            f_select( i );
+            return true;
         }
-        else
-        {
-            m_test_flags &= ~m_test_info[m_current_test].flag;
+    }
+    return false;
+}
 
-            m_current_test = m_highlighted;
-            m_test_info[m_current_test].name[0] = '*';
-            m_test_flags |= m_test_info[m_current_test].flag;
-        }
+bool Defects::set_alpha( float alpha )
+{
+    if( m_current_test == -1 || alpha_limits[m_current_test][0] == alpha_limits[m_current_test][1] )
+    {
+        return false;
     }
-    else
+    m_test_info[m_current_test].alpha = std::min( std::max( alpha, alpha_limits[m_current_test][0] ),
+                                                  alpha_limits[m_current_test][1] );
+    return true;
+}
+
+std::string Defects::state() const
+{
+    if( m_current_test == -1 )
     {
-        m_current_test = m_highlighted;
-        m_test_info[m_current_test].name[0] = '*';
-        m_test_flags |= m_test_info[m_current_test].flag;
+        return "test=off";
     }
+    return "test=" + m_test_info[m_current_test].name.substr( 2 ) +
+           " alpha=" + std::to_string( m_test_info[m_current_test].alpha ) + m_test_result;
 }
 
 void Defects::highlight( bool on )
@@ -204,6 +295,21 @@ void Defects::highlight( bool on )
     m_test_info[m_highlighted].highlighted = on;
 }
 
+void Defects::f_select( int test )
+{
+    if( m_current_test != -1 )
+    {
+        m_test_info[m_current_test].name[0] = ' ';
+        m_test_flags &= ~m_test_info[m_current_test].flag;
+    }
+    m_current_test = test;
+    if( m_current_test != -1 )
+    {
+        m_test_info[m_current_test].name[0] = '*';
+        m_test_flags |= m_test_info[m_current_test].flag;
+    }
+}
+
 void Defects::f_manage_histogram( uint32_t flag )
 {
     if( (m_test_flags & flag) ) {
@@ -351,6 +457,10 @@ cv::Mat &Defects::f_atvl( cv::Mat &src )
             }
         }
         cv::cvtColor( yuv, src, CV_YUV2RGB_I420 );
+        if( !f_measure() )
+        {
+            return src;
+        }
 
         uchar u_mean = cv::saturate_cast< uchar >(mean / double(src.rows * src.cols));
         double variance = 0.f;
@@ -385,12 +495,17 @@ cv::Mat &Defects::f_noise( cv::Mat &src )
 {
     if( (m_test_flags & (1 << Tests::Noise)) )
     {
-        cv::Mat noiseless = src.clone();
+        bool measure = f_measure();
+        cv::Mat noiseless = measure ? src.clone() : cv::Mat();
         cv::Mat gaussian_noise = cv::Mat(src.size(),CV_8UC3);
 
         cv::randn( gaussian_noise, 0, m_test_info[Tests::Noise].alpha - 1.0 );
         src += gaussian_noise;
         cv::normalize( src, src, 0, 255, CV_MINMAX, CV_8UC3 );
+        if( !measure )
+        {
+            return src;
+        }
         float psn = f_peak_sn( noiseless, src );
         if( psn > 0.f )
         {
@@ -478,35 +593,40 @@ cv::Mat &Defects::f_lumaHistogram( cv::Mat &src )
         calcHist( &v, 1, 0, cv::Mat(), hist[2], 1, &h_size, &h_range, true, false );
 
         cv::Size bg_size( 256, 128 );
-        cv::Mat bg( bg_size.height, bg_size.width, CV_8UC3, cv::Scalar(0 ,0, 0 ) );
-
-        cv::normalize(hist[0], hist[0], 0, bg.rows, cv::NORM_MINMAX, -1, cv::Mat() );
-        cv::normalize(hist[1], hist[1], 0, bg.rows, cv::NORM_MINMAX, -1, cv::Mat() );
-        cv::normalize(hist[2], hist[2], 0, bg.rows, cv::NORM_MINMAX, -1, cv::Mat() );
+        cv::normalize(hist[0], hist[0], 0, bg_size.height, cv::NORM_MINMAX, -1, cv::Mat() );
+        cv::normalize(hist[1], hist[1], 0, bg_size.height, cv::NORM_MINMAX, -1, cv::Mat() );
+        cv::normalize(hist[2], hist[2], 0, bg_size.height, cv::NORM_MINMAX, -1, cv::Mat() );
 
-        for( size_t i(1); i < h_size; ++i )
+        // drawn again only if some of the curves has changed, the canvas is kept between the frames
+        std::string key = histogram_key( m_test_flags, hist, bg_size.height );
+        if( m_luma_sprite.stale( key ) )
         {
-            if( (m_test_flags & HistogramFlags::Y_Histogram) ) {
-                cv::line( bg,
-                          cv::Point( (i - 1), bg.rows - cvRound( hist[0].at< float>(i - 1) ) ),
-                          cv::Point( i, bg.rows - cvRound( hist[0].at< float >(i) ) ),
-                          cv::Scalar( 255, 255, 255) );
-            }
-            if( (m_test_flags & HistogramFlags::U_Histogram) ) {
-                cv::line( bg,
-                          cv::Point( (i - 1), bg.rows - cvRound( hist[1].at< float>(i - 1) ) ),
-                          cv::Point( i, bg.rows - cvRound( hist[1].at< float >(i) ) ),
-                          cv::Scalar( 255, 255, 0) );
-            }
-            if( (m_test_flags & HistogramFlags::V_Histogram) ) {
-                cv::line( bg,
-                          cv::Point( (i - 1), bg.rows - cvRound( hist[2].at< float>(i - 1) ) ),
-                          cv::Point( i, bg.rows - cvRound( hist[2].at< float >(i) ) ),
-                          cv::Scalar( 0, 255, 255) );
+            m_luma_sprite.reset( key, bg_size );
+            m_luma_sprite.alpha().setTo( cv::Scalar::all( 255 ) );
+            cv::Mat &bg = m_luma_sprite.image();
+            for( size_t i(1); i < h_size; ++i )
+            {
+                if( (m_test_flags & HistogramFlags::Y_Histogram) ) {
+                    cv::line( bg,
+                              cv::Point( (i - 1), bg.rows - cvRound( hist[0].at< float>(i - 1) ) ),
+                              cv::Point( i, bg.rows - cvRound( hist[0].at< float >(i) ) ),
+                              cv::Scalar( 255, 255, 255) );
+                }
+                if( (m_test_flags & HistogramFlags::U_Histogram) ) {
+                    cv::line( bg,
+                              cv::Point( (i - 1), bg.rows - cvRound( hist[1].at< float>(i - 1) ) ),
+                              cv::Point( i, bg.rows - cvRound( hist[1].at< float >(i) ) ),
+                              cv::Scalar( 255, 255, 0) );
+                }
+                if( (m_test_flags & HistogramFlags::V_Histogram) ) {
+                    cv::line( bg,
+                              cv::Point( (i - 1), bg.rows - cvRound( hist[2].at< float>(i - 1) ) ),
+                              cv::Point( i, bg.rows - cvRound( hist[2].at< float >(i) ) ),
+                              cv::Scalar( 0, 255, 255) );
+                }
             }
         }
-        cv::Mat roi1( src, cv::Rect( 0, src.rows - bg_size.height, bg_size.width, bg_size.height ) );
-        cv::addWeighted( roi1, 0.35, bg, 0.65, 0.0, roi1 );
+        m_luma_sprite.blend( src, cv::Point( 0, src.rows - bg_size.height ), 0.65 );
     }
     return src;
 }
@@ -529,35 +649,40 @@ cv::Mat &Defects::f_chromaHistogram( cv::Mat &src )
         calcHist( &planes[2], 1, 0, cv::Mat(), hist[2], 1, &h_size, &h_range, true, false );
 
         cv::Size bg_size( 256, 128 );
-        cv::Mat bg( bg_size.height, bg_size.width, CV_8UC3, cv::Scalar(0 ,0, 0 ) );
+        cv::normalize(hist[0], hist[0], 0, bg_size.height, cv::NORM_MINMAX, -1, cv::Mat() );
+        cv::normalize(hist[1], hist[1], 0, bg_size.height, cv::NORM_MINMAX, -1, cv::Mat() );
+        cv::normalize(hist[2], hist[2], 0, bg_size.height, cv::NORM_MINMAX, -1, cv::Mat() );
 
-        cv::normalize(hist[0], hist[0], 0, bg.rows, cv::NORM_MINMAX, -1, cv::Mat() );
-        cv::normalize(hist[1], hist[1], 0, bg.rows, cv::NORM_MINMAX, -1, cv::Mat() );
-        cv::normalize(hist[2], hist[2], 0, bg.rows, cv::NORM_MINMAX, -1, cv::Mat() );
-
-        for( int i(1); i < h_size; ++i )
+        // drawn again only if some of the curves has changed, the canvas is kept between the frames
+        std::string key = histogram_key( m_test_flags, hist, bg_size.height );
+        if( m_chroma_sprite.stale( key ) )
         {
-            if( (m_test_flags & HistogramFlags::B_Histogram) ) {
-                line( bg,
-                      cv::Point( (i - 1), bg.rows - cvRound(hist[0].at< float >(i - 1)) ),
-                      cv::Point( i, bg.rows - cvRound(hist[0].at< float >(i)) ),
-                      cv::Scalar( 255, 0, 0) );
-            }
-            if( (m_test_flags & HistogramFlags::G_Histogram) ) {
-                line( bg,
-                      cv::Point( (i - 1), bg.rows - cvRound(hist[1].at< float >(i - 1)) ),
-                      cv::Point( i, bg.rows - cvRound(hist[1].at< float >(i)) ),
-                      cv::Scalar( 0, 255, 0) );
-            }
-            if( (m_test_flags & HistogramFlags::R_Histogram) ) {
-                line( bg,
-                      cv::Point( (i - 1), bg.rows - cvRound(hist[2].at< float >(i - 1)) ),
-                      cv::Point( i, bg.rows - cvRound(hist[2].at< float >(i)) ),
-                      cv::Scalar( 0, 0, 255) );
+            m_chroma_sprite.reset( key, bg_size );
+            m_chroma_sprite.alpha().setTo( cv::Scalar::all( 255 ) );
+            cv::Mat &bg = m_chroma_sprite.image();
+            for( int i(1); i < h_size; ++i )
+            {
+                if( (m_test_flags & HistogramFlags::B_Histogram) ) {
+                    line( bg,
+                          cv::Point( (i - 1), bg.rows - cvRound(hist[0].at< float >(i - 1)) ),
+                          cv::Point( i, bg.rows - cvRound(hist[0].at< float >(i)) ),
+                          cv::Scalar( 255, 0, 0) );
+                }
+                if( (m_test_flags & HistogramFlags::G_Histogram) ) {
+                    line( bg,
+                          cv::Point( (i - 1), bg.rows - cvRound(hist[1].at< float >(i - 1)) ),
+                          cv::Point( i, bg.rows - cvRound(hist[1].at< float >(i)) ),
+                          cv::Scalar( 0, 255, 0) );
+                }
+                if( (m_test_flags & HistogramFlags::R_Histogram) ) {
+                    line( bg,
+                          cv::Point( (i - 1), bg.rows - cvRound(hist[2].at< float >(i - 1)) ),
+                          cv::Point( i, bg.rows - cvRound(hist[2].at< float >(i)) ),
+                          cv::Scalar( 0, 0, 255) );
+                }
             }
         }
-        cv::Mat roi1( src, cv::Rect( 0, src.rows - bg_size.height, bg_size.width, bg_size.height ) );
-        cv::addWeighted( roi1, 0.35, bg, 0.65, 0.0, roi1 );
+        m_chroma_sprite.blend( src, cv::Point( 0, src.rows - bg_size.height ), 0.65 );
     }
     return src;
 }
@@ -5,6 +5,7 @@
 #ifndef VIDEOTESTS_DEFECTS_H
 #define VIDEOTESTS_DEFECTS_H
 
+#include "sprite.h"
 #include <opencv2/core/mat.hpp>
 #include <string>
 
@@ -16,6 +17,7 @@ public:
     ~Defects();
 
     cv::Mat convert( cv::Mat &frame );
+    // the preview overlays, blended from sprites drawn only when their content changes
     cv::Mat &testList( cv::Mat &frame );
     cv::Mat &histogram( cv::Mat &frame );
     cv::Mat &result( cv::Mat &frame );
@@ -52,6 +54,20 @@ public:
 
     void highlight( bool on );
 
+    // the control channel (no keys in headless mode): a test by its name in the list,
+    // "off" stops the current one
+    bool start( const std::string &name );
+    // the parameter of the current test, clamped to the range of the left/right keys
+    bool set_alpha( float alpha );
+    // the current test, its parameter and the last measured result
+    std::string state() const;
+
+    // PSNR and deviation are measured on every n-th frame only
+    void metrics_interval( int n )
+    {
+        m_metrics_interval = n > 0 ? n : 1;
+    }
+
 private:
     enum HistogramFlags { Y_Histogram = 0x0100,
                           U_Histogram = 0x0200,
@@ -61,6 +77,7 @@ private:
                           B_Histogram = 0x2000 };
 
     void f_manage_histogram( uint32_t flag );
+    void f_select( int test );
 
     cv::Mat &f_blur( cv::Mat &src, cv::Size core_size );
     cv::Mat &f_atvl( cv::Mat &src );
@@ -95,6 +112,19 @@ private:
     int m_highlighted {0};
     uint32_t m_test_flags {0u};
     std::string m_test_result;
+    int m_metrics_interval {1};
+    size_t m_frame_count {0};
+
+    Sprite m_list_sprite;
+    Sprite m_result_sprite;
+    Sprite m_luma_sprite;
+    Sprite m_chroma_sprite;
+
+private:
+    bool f_measure() const
+    {
+        return m_frame_count % m_metrics_interval == 0;
+    }
 };
 
 
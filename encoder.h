@@ -5,49 +5,90 @@
 #ifndef VIDEOTESTS_ENCODER_H
 #define VIDEOTESTS_ENCODER_H
 
+#include "options.h"
+
 #include <stdint.h>
-#include <x264.h>
 #include <vector>
 #include <fstream>
-#include <chrono>
+#include <memory>
 #include <opencv2/core/mat.hpp>
 
 class Encoder {
 public:
     using PS = std::vector< uint8_t >;
 
-    Encoder( uint32_t width, uint32_t height, uint32_t fps );
+    class Backend {
+    public:
+        virtual ~Backend() = default;
+
+        virtual void encode( const cv::Mat &rgb, int delay, PS *sps, PS *pps ) = 0;
+        virtual void store( std::ofstream &f ) = 0;
+        virtual void request_keyframe()
+        {}
+        // 0 - default, higher levels trade quality for encoding time
+        virtual void set_speed( int level )
+        {}
+
+        const uint8_t *data() const
+        {
+            return m_data;
+        }
+        uint32_t size() const
+        {
+            return m_size;
+        }
+        bool keyframe() const
+        {
+            return m_keyframe;
+        }
+
+    protected:
+        const uint8_t *m_data {nullptr};
+        uint32_t m_size {0};
+        bool m_keyframe {false};
+    };
+
+    Encoder( const Options &options, uint32_t width, uint32_t height, uint32_t fps );
     ~Encoder();
 
-    void encode( const cv::Mat &rgb, int delay, PS *sps, PS *pps );
-    void store( std::ofstream &f );
+    void encode( const cv::Mat &rgb, int delay, PS *sps, PS *pps )
+    {
+        m_backend->encode( rgb, delay, sps, pps );
+    }
+    void store( std::ofstream &f )
+    {
+        m_backend->store( f );
+    }
+    void request_keyframe()
+    {
+        m_backend->request_keyframe();
+    }
+    void set_speed( int level )
+    {
+        m_backend->set_speed( level );
+    }
 
-    const uint8_t *nalunit() const
+    Codec codec() const
+    {
+        return m_codec;
+    }
+    // encoded frame: H.264 slice NAL unit or JPEG image
+    const uint8_t *data() const
     {
-        return m_nalunit;
+        return m_backend->data();
     }
-    uint32_t nalusize() const
+    uint32_t size() const
     {
-        return m_nalusz;
+        return m_backend->size();
     }
     bool keyframe() const
     {
-        return m_nalutype == nal_unit_type_e::NAL_SLICE_IDR;
+        return m_backend->keyframe();
     }
 
 private:
-    x264_t *m_encoder;
-
-    x264_param_t m_params;
-    x264_picture_t m_picture;
-    x264_nal_t *m_nalunits {nullptr};
-
-    uint8_t *m_nalunit {nullptr};
-    uint32_t m_nalusz {0};
-    uint8_t m_nalutype {nal_unit_type_e::NAL_UNKNOWN};
-
-private:
-    uint32_t f_store_nalunit( uint8_t *ptr, PS *sps, PS *pps );
+    Codec m_codec;
+    std::unique_ptr< Backend > m_backend;
 };
 
 
@@ -0,0 +1,194 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#include "framepool.h"
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+FramePool *FramePool::install( uint32_t flags )
+{
+    if( !(flags & Enabled) )
+    {
+        return nullptr;
+    }
+    FramePool *pool = new FramePool( flags );
+    cv::Mat::setDefaultAllocator( pool );
+    return pool;
+}
+
+FramePool::FramePool( uint32_t flags )
+: m_flags( flags )
+, m_std( cv::Mat::getStdAllocator() )
+{}
+
+cv::UMatData *FramePool::allocate( int dims, const int *sizes, int type, void *data, size_t *step,
+                                   cv::AccessFlag flags, cv::UMatUsageFlags usage ) const
+{
+    size_t total = CV_ELEM_SIZE( type );
+    for( int i = dims - 1; i >= 0; --i )
+    {
+        total *= sizes[i];
+    }
+    if( data || total < MIN_SIZE )
+    {
+        // user data and small matrices (histograms, overlays) are not worth pooling
+        return m_std->allocate( dims, sizes, type, data, step, flags, usage );
+    }
+
+    if( step )
+    {
+        size_t s = CV_ELEM_SIZE( type );
+        for( int i = dims - 1; i >= 0; --i )
+        {
+            step[i] = s;
+            s *= sizes[i];
+        }
+    }
+
+    int node = f_node();
+    size_t size = f_class( total );
+    void *ptr = nullptr;
+    {
+        std::lock_guard< std::mutex > lk( m_mutex );
+        auto &free = m_free[{ node, size }];
+        if( !free.empty() )
+        {
+            ptr = free.back();
+            free.pop_back();
+            m_stats.cached -= size;
+            ++m_stats.hits;
+        }
+        else
+        {
+            ++m_stats.misses;
+        }
+    }
+    if( !ptr )
+    {
+        ptr = f_map( size, node );
+        std::lock_guard< std::mutex > lk( m_mutex );
+        m_stats.mapped += size;
+    }
+
+    cv::UMatData *u = new cv::UMatData( this );
+    u->data = u->origdata = (uchar *)ptr;
+    u->size = total;
+    u->userdata = (void *)intptr_t( node );
+    return u;
+}
+
+bool FramePool::allocate( cv::UMatData *data, cv::AccessFlag flags, cv::UMatUsageFlags usage ) const
+{
+    return data != nullptr;
+}
+
+void FramePool::deallocate( cv::UMatData *u ) const
+{
+    if( !u )
+    {
+        return;
+    }
+    int node = int(intptr_t( u->userdata ));
+    size_t size = f_class( u->size );
+    void *ptr = u->origdata;
+    u->userdata = nullptr;
+    delete u;
+
+    {
+        std::lock_guard< std::mutex > lk( m_mutex );
+        auto &free = m_free[{ node, size }];
+        if( free.size() < MAX_FREE )
+        {
+            free.push_back( ptr );
+            m_stats.cached += size;
+            return;
+        }
+        ++m_stats.unmapped;
+        m_stats.mapped -= size;
+    }
+    munmap( ptr, size );
+}
+
+FramePool::Stats FramePool::stats() const
+{
+    std::lock_guard< std::mutex > lk( m_mutex );
+    return m_stats;
+}
+
+size_t FramePool::f_class( size_t size ) const
+{
+    if( (m_flags & HugePages) )
+    {
+        return (size + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1);
+    }
+    // eight classes per power of two: at most an eighth of a buffer is wasted,
+    // and frames of close sizes (odd strides, a scaled output) share a class
+    size_t step = (size_t(1) << (63 - __builtin_clzll( size ))) / 8;
+    if( step < PAGE )
+    {
+        step = PAGE;
+    }
+    return (size + step - 1) / step * step;
+}
+
+int FramePool::f_node() const
+{
+    unsigned cpu = 0, node = 0;
+    if( !(m_flags & Numa) || syscall( SYS_getcpu, &cpu, &node, nullptr ) != 0 )
+    {
+        return 0;
+    }
+    return int(node);
+}
+
+void *FramePool::f_map( size_t size, int node ) const
+{
+    void *ptr = MAP_FAILED;
+    if( (m_flags & HugePages) )
+    {
+        bool hugetlb;
+        {
+            std::lock_guard< std::mutex > lk( m_mutex );
+            hugetlb = m_hugetlb;
+        }
+        if( hugetlb )
+        {
+            ptr = mmap( nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+            if( ptr == MAP_FAILED )
+            {
+                std::lock_guard< std::mutex > lk( m_mutex );
+                if( m_hugetlb )
+                {
+                    m_hugetlb = false;
+                    std::cerr << "[*] frame pool: no reserved huge pages (vm.nr_hugepages), transparent ones are used\n";
+                }
+            }
+        }
+    }
+    if( ptr == MAP_FAILED )
+    {
+        ptr = mmap( nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+        if( ptr == MAP_FAILED )
+        {
+            throw std::bad_alloc();
+        }
+        if( (m_flags & HugePages) )
+        {
+            madvise( ptr, size, MADV_HUGEPAGE );
+        }
+    }
+    if( (m_flags & Numa) && node < 64 )
+    {
+        // the pages come from the node of the thread that uses the buffer, wherever it is freed
+        unsigned long mask = 1ul << node;
+        (void)syscall( SYS_mbind, ptr, size, MPOL_PREFERRED, &mask, sizeof(mask) * 8 + 1, 0 );
+    }
+    return ptr;
+}
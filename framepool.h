@@ -0,0 +1,69 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#ifndef VIDEODEFECTS_FRAMEPOOL_H
+#define VIDEODEFECTS_FRAMEPOOL_H
+
+#include <opencv2/core/mat.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Default allocator of cv::Mat for the whole process: frame-sized buffers (decoded frames,
+// their clones, the YUV and gray planes of the defects and of the encoder) go back to a
+// free list of their size class instead of malloc, so at a steady frame size the pipeline
+// stops allocating. Buffers are mapped directly, optionally on huge pages and on the NUMA
+// node of the thread that asked for them. Small matrices go to the standard allocator.
+class FramePool: public cv::MatAllocator {
+public:
+    enum Flags { Enabled = 0x01, HugePages = 0x02, Numa = 0x04 };
+
+    static const size_t MIN_SIZE = 64 * 1024;           // smaller ones are not pooled
+    static const size_t MAX_FREE = 8;                   // cached buffers per size class and node
+    static const size_t PAGE = 4096;
+    static const size_t HUGE_PAGE = 2 * 1024 * 1024;
+
+    struct Stats
+    {
+        uint64_t hits;          // served from a free list
+        uint64_t misses;        // mapped anew
+        uint64_t unmapped;      // returned to the kernel, the free list was full
+        size_t mapped;          // bytes, in use and cached
+        size_t cached;          // bytes on the free lists
+    };
+
+    // installs the pool as the default allocator; it is never destroyed, the frames may
+    // outlive main(). nullptr if the flags do not enable it
+    static FramePool *install( uint32_t flags );
+
+    cv::UMatData *allocate( int dims, const int *sizes, int type, void *data, size_t *step,
+                            cv::AccessFlag flags, cv::UMatUsageFlags usage ) const override;
+    bool allocate( cv::UMatData *data, cv::AccessFlag flags, cv::UMatUsageFlags usage ) const override;
+    void deallocate( cv::UMatData *data ) const override;
+
+    // thread-safe
+    Stats stats() const;
+
+private:
+    explicit FramePool( uint32_t flags );
+
+    size_t f_class( size_t size ) const;
+    int f_node() const;
+    void *f_map( size_t size, int node ) const;
+
+private:
+    uint32_t m_flags;
+    const cv::MatAllocator *m_std;
+
+    mutable std::mutex m_mutex;     // guards everything below
+    mutable std::map< std::pair< int, size_t >, std::vector< void * > > m_free;  // by node and size class
+    mutable Stats m_stats {};
+    mutable bool m_hugetlb {true};  // reserved huge pages are worth trying
+};
+
+
+#endif //VIDEODEFECTS_FRAMEPOOL_H
@@ -0,0 +1,101 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#include "governor.h"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+namespace {
+
+    const Governor::Level levels[] = {
+        { 1, 0, 1.0  },
+        { 2, 0, 1.0  },
+        { 4, 0, 1.0  },
+        { 4, 1, 1.0  },
+        { 4, 2, 1.0  },
+        { 8, 2, 0.75 },
+        { 8, 2, 0.5  }
+    };
+    const int level_count = sizeof(levels) / sizeof(levels[0]);
+
+    const char *stage_names[Governor::Stages] = { "read", "defects", "preview", "encode", "send" };
+
+}  // namespace
+
+
+Governor::Governor( double fps )
+: m_budget( 1000. / std::max( fps, 1. ) )
+, m_frames_over( std::max( int(fps / 4), 1 ) )
+, m_frames_under( std::max( int(fps * 2), 1 ) )
+, m_holdoff( std::max( int(fps), 1 ) )
+{
+    for( auto &us : m_stage_us )
+    {
+        us.store( 0 );
+    }
+}
+
+void Governor::report( Stage stage, std::chrono::steady_clock::duration time )
+{
+    m_stage_us[stage].store( std::chrono::duration_cast< std::chrono::microseconds >( time ).count() );
+}
+
+bool Governor::update()
+{
+    double ms[Stages];
+    for( int i(0); i < Stages; ++i )
+    {
+        ms[i] = m_stage_us[i].load() / 1000.;
+    }
+    // the pipeline and the stream thread run in parallel: the busiest one limits the frame rate
+    double busy = std::max( ms[Read] + ms[Defects] + ms[Preview], ms[Encode] + ms[Send] );
+    m_load = m_load * 0.8 + busy / m_budget * 0.2;
+
+    if( m_hold > 0 )
+    {
+        --m_hold;
+        return false;
+    }
+
+    m_over = m_load > HIGH_LOAD ? m_over + 1 : 0;
+    m_under = m_load < LOW_LOAD ? m_under + 1 : 0;
+    if( m_over >= m_frames_over && m_level + 1 < level_count )
+    {
+        f_step( m_level + 1, ms );
+        return true;
+    }
+    if( m_under >= m_frames_under && m_level > 0 )
+    {
+        f_step( m_level - 1, ms );
+        return true;
+    }
+    return false;
+}
+
+const Governor::Level &Governor::level() const
+{
+    return levels[m_level];
+}
+
+void Governor::f_step( int level, double stage_ms[] )
+{
+    char buf[256];
+    snprintf( buf, sizeof(buf), "[governor] load %d%% (", int(m_load * 100.) );
+    std::cerr << buf;
+    for( int i(0); i < Stages; ++i )
+    {
+        snprintf( buf, sizeof(buf), "%s %.1f%s", stage_names[i], stage_ms[i], i + 1 < Stages ? ", " : "" );
+        std::cerr << buf;
+    }
+    const Level &l = levels[level];
+    snprintf( buf, sizeof(buf), " ms of %.1f): level %d -> %d (metrics 1/%d, encoder speed %d, scale %.2f)\n",
+              m_budget, m_level, level, l.metrics_interval, l.encoder_speed, l.scale );
+    std::cerr << buf;
+
+    m_level = level;
+    m_encoder_speed.store( l.encoder_speed );
+    m_over = m_under = 0;
+    m_hold = m_holdoff;
+}
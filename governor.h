@@ -0,0 +1,65 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#ifndef VIDEODEFECTS_GOVERNOR_H
+#define VIDEODEFECTS_GOVERNOR_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Keeps the pipeline within the frame budget (1000 / fps ms). Every frame the pipeline
+// reports per-stage times; when the busiest thread stays over the budget the governor
+// steps down one level (less frequent metrics, faster encoder, smaller output), when it
+// stays well under the budget it steps back up. Every decision is reported to stderr.
+class Governor {
+public:
+    enum Stage { Read, Defects, Preview, Encode, Send, Stages };
+
+    struct Level
+    {
+        int metrics_interval;   // defect metrics (PSNR, deviation) every n-th frame
+        int encoder_speed;      // Encoder::set_speed() level
+        double scale;           // output (encoded) frame scale
+    };
+
+    explicit Governor( double fps );
+    Governor( const Governor& orig ) = delete;
+    Governor &operator =( const Governor& orig ) = delete;
+
+    // thread-safe
+    void report( Stage stage, std::chrono::steady_clock::duration time );
+    int encoder_speed() const
+    {
+        return m_encoder_speed.load();
+    }
+
+    // called by the pipeline thread once per frame, returns true when the level changed
+    bool update();
+    const Level &level() const;
+
+private:
+    static constexpr double HIGH_LOAD = 0.9;
+    static constexpr double LOW_LOAD = 0.6;
+
+    double m_budget;
+    int m_frames_over;
+    int m_frames_under;
+    int m_holdoff;
+
+    std::atomic< uint32_t > m_stage_us[Stages];
+    std::atomic< int > m_encoder_speed {0};
+
+    double m_load {0.};
+    int m_level {0};
+    int m_over {0};
+    int m_under {0};
+    int m_hold {0};
+
+private:
+    void f_step( int level, double stage_ms[] );
+};
+
+
+#endif //VIDEODEFECTS_GOVERNOR_H
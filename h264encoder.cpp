@@ -0,0 +1,189 @@
+//
+// Created by mkh on 09.02.2024.
+//
+
+#include "h264encoder.h"
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/imgproc/types_c.h>
+
+namespace {
+    uint32_t get_avcC_size( uint8_t *ptr ) {
+        uint32_t rc;
+        ::memcpy( &rc, ptr, sizeof(rc) );
+
+        return be32toh( rc );
+    }
+} // namespace
+
+namespace {
+    struct Speed
+    {
+        const char *preset;
+        int threads;
+    };
+    // ступени ускорения кодера: ultrafast меняется на лету, число потоков - только пересозданием
+    const Speed speeds[] = { { "superfast", 6 }, { "ultrafast", 6 }, { "ultrafast", 12 } };
+    const int speed_count = sizeof(speeds) / sizeof(speeds[0]);
+} // namespace
+
+H264Encoder::H264Encoder( const Options &options, uint32_t width, uint32_t height, uint32_t fps  )
+: m_options( options )
+, m_width( width )
+, m_height( height )
+, m_fps( fps )
+{
+    f_configure( speeds[0].preset, speeds[0].threads );
+
+    x264_picture_init( &m_picture );
+    m_picture.img.i_csp = X264_CSP_I420;
+    m_picture.img.i_plane = 3;
+    m_picture.img.i_stride[0] = width;
+    m_picture.img.i_stride[1] = width >> 1;
+    m_picture.img.i_stride[2] = width >> 1;
+    m_picture.i_pts = rand();
+    if( !(m_encoder = x264_encoder_open( &m_params ) ) )
+        throw std::logic_error( "[x264_enc] failed to open encoder" );
+}
+
+H264Encoder::~H264Encoder()
+{
+    x264_encoder_close( m_encoder );
+}
+
+void H264Encoder::encode( const cv::Mat &rgb, int delay, Encoder::PS *sps, Encoder::PS *pps ) {
+    cv::Mat yuv;
+    cv::cvtColor( rgb, yuv, CV_RGB2YUV_I420 );
+
+    m_picture.img.plane[ 0 ] = yuv.data;
+    m_picture.img.plane[ 1 ] = yuv.data + rgb.rows * rgb.cols + ((rgb.rows * rgb.cols) >> 2);
+    m_picture.img.plane[ 2 ] = yuv.data + rgb.rows * rgb.cols;
+
+    m_picture.i_pts += delay;
+    m_picture.i_type = X264_TYPE_AUTO;
+    if( m_keyframe_requested ) {
+        // with periodic intra refresh a new refresh wave replaces the IDR spike
+        if( m_params.b_intra_refresh ) {
+            x264_encoder_intra_refresh( m_encoder );
+        }
+        else {
+            m_picture.i_type = X264_TYPE_IDR;
+        }
+        m_keyframe_requested = false;
+    }
+
+    int nals_count{0};
+    x264_picture_t picture_out;
+
+    m_size = 0;
+    m_payload_size = 0;
+    int size = x264_encoder_encode( m_encoder, &m_nalunits, &nals_count, &m_picture, &picture_out );
+    if( size > 0 && m_nalunits->p_payload ) {
+        m_keyframe = picture_out.b_keyframe;
+        m_payload = m_nalunits->p_payload;
+        m_payload_size = size;
+
+        uint8_t *ptr = m_nalunits->p_payload;
+        while( ptr < m_nalunits->p_payload + size ) {
+            ptr += f_store_nalunit( ptr, sps, pps ) + sizeof(uint32_t);
+        }
+    }
+}
+
+void H264Encoder::store( std::ofstream &f )
+{
+    static const char start_code[] = { 0, 0, 0, 1 };
+
+    uint8_t *ptr = m_payload;
+    while( ptr < m_payload + m_payload_size ) {
+        uint32_t sz = get_avcC_size( ptr );
+        ptr += sizeof( sz );
+
+        f.write( start_code, sizeof(start_code) );
+        f.write( (const char *)ptr, sz );
+        ptr += sz;
+    }
+}
+
+void H264Encoder::set_speed( int level )
+{
+    level = std::min( std::max( level, 0 ), speed_count - 1 );
+    if( level == m_speed ) {
+        return;
+    }
+
+    int threads = m_params.i_threads;
+    f_configure( speeds[level].preset, speeds[level].threads );
+    if( m_params.i_threads != threads ) {
+        x264_encoder_close( m_encoder );
+        if( !(m_encoder = x264_encoder_open( &m_params ) ) )
+            throw std::logic_error( "[x264_enc] failed to reopen encoder" );
+    }
+    else if( x264_encoder_reconfig( m_encoder, &m_params ) < 0 ) {
+        throw std::logic_error( "[x264_enc] failed to reconfigure encoder" );
+    }
+    m_speed = level;
+}
+
+void H264Encoder::f_configure( const char *preset, int threads )
+{
+    x264_param_default( &m_params );
+    if( x264_param_default_preset( &m_params, preset, "animation" ) ) {
+        throw std::logic_error( std::string("[x264_enc] failed to set ") + preset + " preset" );
+    }
+
+    m_params.i_csp = X264_CSP_YV12;
+    m_params.i_threads = threads;
+    m_params.i_width = m_width;
+    m_params.i_height = m_height;
+
+    m_params.i_fps_num = m_fps;
+    m_params.i_fps_den = 1;
+
+    // Intra refres:
+    m_params.i_keyint_max = m_params.i_fps_num;
+    m_params.b_intra_refresh = m_options.intra_refresh;
+    //For streaming:
+    m_params.b_repeat_headers = 1;
+    m_params.b_annexb = 0;
+
+    //Rate control
+    if( m_options.bitrate ) {
+        // CBR: VBV caps every frame, so IDRs do not burst over the link
+        m_params.rc.i_rc_method = X264_RC_ABR;
+        m_params.rc.i_bitrate = m_options.bitrate;
+        m_params.rc.i_vbv_max_bitrate = m_options.vbv_maxrate ? m_options.vbv_maxrate : m_options.bitrate;
+        m_params.rc.i_vbv_buffer_size = m_options.vbv_bufsize ? m_options.vbv_bufsize
+                                                              : std::max( 2 * m_params.rc.i_vbv_max_bitrate / int(m_fps), 1 );
+    }
+    else {
+        m_params.rc.i_rc_method = X264_RC_CRF;
+        m_params.rc.f_rf_constant = 23;
+        m_params.rc.f_rf_constant_max = m_params.rc.f_rf_constant;
+    }
+
+    if( x264_param_apply_profile( &m_params, "baseline" ) < 0 )
+        throw std::logic_error( "[x264_enc] failed to set baseline profile" );
+}
+
+uint32_t H264Encoder::f_store_nalunit( uint8_t *ptr, Encoder::PS *sps, Encoder::PS *pps )
+{
+    uint32_t sz = get_avcC_size( ptr );
+    ptr += sizeof( sz );
+
+    m_nalutype = (*ptr) & 0x1f;
+    if( m_nalutype == nal_unit_type_e::NAL_SPS ) {
+        *sps = Encoder::PS(ptr, ptr + sz);
+    }
+    else if( m_nalutype == nal_unit_type_e::NAL_PPS ) {
+        *pps = Encoder::PS(ptr, ptr + sz);
+    }
+    else if( m_nalutype >= nal_unit_type_e::NAL_SLICE && m_nalutype <= nal_unit_type_e::NAL_SLICE_IDR ) {
+        m_data = ptr;
+        m_size = sz;
+    }
+
+    return sz;
+}
@@ -0,0 +1,48 @@
+//
+// Created by mkh on 09.02.2024.
+//
+
+#ifndef VIDEODEFECTS_H264ENCODER_H
+#define VIDEODEFECTS_H264ENCODER_H
+
+#include "encoder.h"
+#include <x264.h>
+
+class H264Encoder: public Encoder::Backend {
+public:
+    H264Encoder( const Options &options, uint32_t width, uint32_t height, uint32_t fps );
+    ~H264Encoder() override;
+
+    void encode( const cv::Mat &rgb, int delay, Encoder::PS *sps, Encoder::PS *pps ) override;
+    void store( std::ofstream &f ) override;
+    void request_keyframe() override
+    {
+        m_keyframe_requested = true;
+    }
+    void set_speed( int level ) override;
+
+private:
+    Options m_options;
+    uint32_t m_width;
+    uint32_t m_height;
+    uint32_t m_fps;
+    int m_speed {0};
+
+    x264_t *m_encoder;
+
+    x264_param_t m_params;
+    x264_picture_t m_picture;
+    x264_nal_t *m_nalunits {nullptr};
+    uint8_t *m_payload {nullptr};
+    int m_payload_size {0};
+
+    uint8_t m_nalutype {nal_unit_type_e::NAL_UNKNOWN};
+    bool m_keyframe_requested {false};
+
+private:
+    void f_configure( const char *preset, int threads );
+    uint32_t f_store_nalunit( uint8_t *ptr, Encoder::PS *sps, Encoder::PS *pps );
+};
+
+
+#endif //VIDEODEFECTS_H264ENCODER_H
@@ -0,0 +1,354 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#include "segmenter.h"
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+    void put_length( std::vector< uint8_t > &out, uint32_t size )
+    {
+        uint32_t be = htobe32( size );
+        const uint8_t *p = (const uint8_t *)&be;
+        out.insert( out.end(), p, p + sizeof(be) );
+    }
+
+    std::string seconds( uint64_t ticks )
+    {
+        char buf[32];
+        snprintf( buf, sizeof(buf), "%.3f", double(ticks) / mp4::Muxer::TIMESCALE );
+        return buf;
+    }
+
+}  // namespace
+
+
+http::Segmenter::Segmenter()
+: m_wakeup( eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC ) )
+{
+    if( m_wakeup == -1 )
+    {
+        throw std::runtime_error( std::string("[http] eventfd failed: ") + strerror( errno ) );
+    }
+}
+
+http::Segmenter::~Segmenter()
+{
+    close( m_wakeup );
+}
+
+void http::Segmenter::store( const Encoder::PS &sps,
+                             const Encoder::PS &pps,
+                             const uint8_t *data,
+                             size_t size,
+                             bool keyframe,
+                             int delay,
+                             int width,
+                             int height )
+{
+    bool new_init = keyframe && !sps.empty() && !pps.empty() &&
+                    (sps != m_sps || pps != m_pps || width != m_width || height != m_height);
+    if( !new_init && m_sps.empty() )
+    {
+        // nothing to decode it with yet
+        return;
+    }
+
+    bool open = false;
+    {
+        std::lock_guard< std::mutex > lk( m_mutex );
+        open = !m_segments.empty() && !m_segments.back().complete;
+    }
+    if( (keyframe || new_init) && (open || !m_samples.empty()) )
+    {
+        // a keyframe starts a part, and a segment once the current one is long enough
+        bool end_segment = new_init || m_segment_duration + m_part_duration >= SEGMENT_TARGET;
+        if( end_segment || !m_samples.empty() )
+        {
+            f_part( end_segment );
+        }
+    }
+
+    if( new_init )
+    {
+        // the decode time starts over with the new initialization segment
+        auto init = std::make_shared< std::vector< uint8_t > >();
+        m_muxer.init( *init, sps, pps, width, height );
+        m_sps = sps;
+        m_pps = pps;
+        m_width = width;
+        m_height = height;
+
+        std::lock_guard< std::mutex > lk( m_mutex );
+        m_inits[++m_init] = init;
+        m_discontinuity = m_init > 1;
+    }
+
+    if( keyframe )
+    {
+        m_gop_frames = m_since_keyframe;
+        m_since_keyframe = 0;
+    }
+    ++m_since_keyframe;
+
+    uint32_t duration = uint32_t(delay) * (mp4::Muxer::TIMESCALE / 1000);
+    put_length( m_sample_data, size );
+    m_sample_data.insert( m_sample_data.end(), data, data + size );
+    m_samples.push_back( mp4::Sample{ nullptr, uint32_t(size + sizeof(uint32_t)), duration, keyframe } );
+    m_part_duration += duration;
+
+    // parts of about the same length: the keyframe interval split evenly, not a short part at its end
+    size_t frames = std::max< size_t >( 1, PART_TARGET / std::max< uint32_t >( duration, 1 ) );
+    if( m_gop_frames )
+    {
+        size_t parts = (m_gop_frames + frames - 1) / frames;
+        frames = (m_gop_frames + parts - 1) / parts;
+    }
+    // published as soon as it is full, not when the next frame comes: a frame less of latency
+    if( m_samples.size() >= frames || m_part_duration + duration > PART_TARGET )
+    {
+        f_part( m_segment_duration + m_part_duration + PART_TARGET > SEGMENT_MAX );
+    }
+}
+
+void http::Segmenter::notify()
+{
+    uint64_t one = 1;
+    (void)!::write( m_wakeup, &one, sizeof(one) );
+}
+
+http::Segmenter::Status http::Segmenter::init( size_t id, Buffer &out )
+{
+    std::lock_guard< std::mutex > lk( m_mutex );
+    auto i = m_inits.find( id );
+    if( i != m_inits.end() )
+    {
+        out = i->second;
+        return Status::Ready;
+    }
+    return id == m_init + 1 ? Status::Pending : Status::Missing;
+}
+
+http::Segmenter::Status http::Segmenter::playlist( int64_t msn, int64_t part, Buffer &out )
+{
+    std::lock_guard< std::mutex > lk( m_mutex );
+    if( !m_playlist )
+    {
+        return Status::Pending;
+    }
+    if( msn >= 0 )
+    {
+        uint64_t current = f_current();
+        // RFC 8216bis: more than two segments ahead is a bad request
+        if( uint64_t(msn) > current + 2 )
+        {
+            return Status::Missing;
+        }
+        const Segment *seg = f_find( msn );
+        bool reached = uint64_t(msn) < current ||
+                       (seg && part >= 0 && size_t(part) < seg->parts.size());
+        if( !reached )
+        {
+            return Status::Pending;
+        }
+    }
+    out = m_playlist;
+    return Status::Ready;
+}
+
+http::Segmenter::Status http::Segmenter::segment( uint64_t msn, std::vector< Buffer > &out )
+{
+    std::lock_guard< std::mutex > lk( m_mutex );
+    const Segment *seg = f_find( msn );
+    if( seg && seg->complete )
+    {
+        for( const auto &p : seg->parts )
+        {
+            out.push_back( p.data );
+        }
+        return Status::Ready;
+    }
+    uint64_t current = f_current();
+    return msn >= current && msn <= current + 1 ? Status::Pending : Status::Missing;
+}
+
+http::Segmenter::Status http::Segmenter::part( uint64_t msn, size_t index, Buffer &out )
+{
+    std::lock_guard< std::mutex > lk( m_mutex );
+    const Segment *seg = f_find( msn );
+    if( seg && index < seg->parts.size() )
+    {
+        out = seg->parts[index].data;
+        return Status::Ready;
+    }
+    // the preload hint: the next part of the open segment or the first of the next one
+    if( seg ? !seg->complete : msn == f_current() )
+    {
+        return Status::Pending;
+    }
+    return Status::Missing;
+}
+
+void http::Segmenter::fetch( uint64_t &seq, std::vector< Part > &parts )
+{
+    std::lock_guard< std::mutex > lk( m_mutex );
+    if( !seq )
+    {
+        // a new client starts with the last part it can decode
+        const Part *start = nullptr;
+        for( auto s = m_segments.rbegin(); s != m_segments.rend() && !start; ++s )
+        {
+            for( auto p = s->parts.rbegin(); p != s->parts.rend() && !start; ++p )
+            {
+                if( p->independent )
+                {
+                    start = &*p;
+                }
+            }
+        }
+        if( !start )
+        {
+            return;
+        }
+        seq = start->seq - 1;
+    }
+    for( const auto &s : m_segments )
+    {
+        for( const auto &p : s.parts )
+        {
+            if( p.seq > seq )
+            {
+                parts.push_back( p );
+            }
+        }
+    }
+    if( !parts.empty() )
+    {
+        seq = parts.back().seq;
+    }
+}
+
+void http::Segmenter::f_part( bool end_segment )
+{
+    Buffer data;
+    if( !m_samples.empty() )
+    {
+        const uint8_t *ptr = m_sample_data.data();
+        for( auto &s : m_samples )
+        {
+            s.data = ptr;
+            ptr += s.size;
+        }
+        // muxed once, every client gets the same buffer
+        auto out = std::make_shared< std::vector< uint8_t > >();
+        out->reserve( m_sample_data.size() + 64 + m_samples.size() * 12 );
+        m_muxer.fragment( *out, m_samples );
+        data = out;
+    }
+
+    {
+        std::lock_guard< std::mutex > lk( m_mutex );
+        if( data )
+        {
+            if( m_segments.empty() || m_segments.back().complete )
+            {
+                m_segments.push_back( Segment{ m_msn++, m_init, m_discontinuity, {}, 0, false } );
+                m_discontinuity = false;
+            }
+            Segment &seg = m_segments.back();
+            seg.parts.push_back( Part{ ++m_seq, m_init, data, m_part_duration, m_samples.front().keyframe } );
+            seg.duration += m_part_duration;
+        }
+        if( end_segment && !m_segments.empty() && !m_segments.back().complete )
+        {
+            m_segments.back().complete = true;
+            while( m_segments.size() > WINDOW )
+            {
+                if( m_segments.front().discontinuity )
+                {
+                    ++m_discontinuity_sequence;
+                }
+                m_segments.pop_front();
+            }
+            while( m_inits.size() > 1 && m_inits.begin()->first < m_segments.front().init )
+            {
+                m_inits.erase( m_inits.begin() );
+            }
+        }
+        f_playlist();
+    }
+
+    m_segment_duration = end_segment ? 0 : m_segment_duration + m_part_duration;
+    m_samples.clear();
+    m_sample_data.clear();
+    m_part_duration = 0;
+    notify();
+}
+
+uint64_t http::Segmenter::f_current() const
+{
+    return !m_segments.empty() && !m_segments.back().complete ? m_segments.back().msn : m_msn;
+}
+
+const http::Segmenter::Segment *http::Segmenter::f_find( uint64_t msn ) const
+{
+    if( m_segments.empty() || msn < m_segments.front().msn || msn > m_segments.back().msn )
+    {
+        return nullptr;
+    }
+    return &m_segments[msn - m_segments.front().msn];
+}
+
+void http::Segmenter::f_playlist()
+{
+    if( m_segments.empty() )
+    {
+        return;
+    }
+    std::string s = "#EXTM3U\n"
+                    "#EXT-X-VERSION:9\n"
+                    "#EXT-X-TARGETDURATION:" + std::to_string( SEGMENT_MAX / mp4::Muxer::TIMESCALE ) + "\n"
+                    "#EXT-X-PART-INF:PART-TARGET=" + seconds( PART_TARGET ) + "\n"
+                    "#EXT-X-SERVER-CONTROL:CAN-BLOCK-RELOAD=YES,PART-HOLD-BACK=" + seconds( 3 * PART_TARGET ) + "\n"
+                    "#EXT-X-MEDIA-SEQUENCE:" + std::to_string( m_segments.front().msn ) + "\n"
+                    "#EXT-X-DISCONTINUITY-SEQUENCE:" + std::to_string( m_discontinuity_sequence ) + "\n";
+
+    size_t parts_from = m_segments.size() > PART_SEGMENTS ? m_segments.size() - PART_SEGMENTS : 0;
+    size_t init = 0;
+    for( size_t i = 0; i < m_segments.size(); ++i )
+    {
+        const Segment &seg = m_segments[i];
+        std::string msn = std::to_string( seg.msn );
+        if( seg.discontinuity )
+        {
+            s += "#EXT-X-DISCONTINUITY\n";
+        }
+        if( seg.init != init )
+        {
+            init = seg.init;
+            s += "#EXT-X-MAP:URI=\"init" + std::to_string( init ) + ".mp4\"\n";
+        }
+        for( size_t j = 0; i >= parts_from && j < seg.parts.size(); ++j )
+        {
+            s += "#EXT-X-PART:DURATION=" + seconds( seg.parts[j].duration ) +
+                 ",URI=\"part" + msn + "." + std::to_string( j ) + ".m4s\"" +
+                 (seg.parts[j].independent ? ",INDEPENDENT=YES\n" : "\n");
+        }
+        if( seg.complete )
+        {
+            s += "#EXTINF:" + seconds( seg.duration ) + ",\nseg" + msn + ".m4s\n";
+        }
+    }
+    const Segment &last = m_segments.back();
+    s += "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"part" + std::to_string( f_current() ) + "." +
+         std::to_string( last.complete ? 0 : last.parts.size() ) + ".m4s\"\n";
+
+    m_playlist = std::make_shared< const std::vector< uint8_t > >( s.begin(), s.end() );
+}
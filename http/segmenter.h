@@ -0,0 +1,122 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#ifndef HTTP_SEGMENTER_H
+#define HTTP_SEGMENTER_H
+
+#include "../encoder.h"
+#include "../mp4.h"
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace http {
+
+    // muxed data shared by all the HTTP clients, never changed once published
+    using Buffer = std::shared_ptr< const std::vector< uint8_t > >;
+
+    // Muxes the encoded access units into fMP4 on the stream thread, once for all HTTP clients:
+    // partial segments (a moof+mdat each) of at most PART_TARGET, segments of them starting
+    // at a keyframe, and the LL-HLS playlist describing the last WINDOW segments
+    class Segmenter {
+    public:
+        static const uint32_t PART_TARGET = mp4::Muxer::TIMESCALE / 2;         // 0.5 s
+        static const uint32_t SEGMENT_TARGET = 2 * mp4::Muxer::TIMESCALE;      // cut at the first keyframe after that
+        static const uint32_t SEGMENT_MAX = 4 * mp4::Muxer::TIMESCALE;         // cut without a keyframe, EXT-X-TARGETDURATION
+        static const size_t WINDOW = 6;             // complete segments in the playlist
+        static const size_t PART_SEGMENTS = 3;      // the last segments listed with their parts
+
+        enum class Status { Ready, Pending, Missing };
+
+        struct Part
+        {
+            uint64_t seq;           // over the whole stream, for the progressive clients
+            size_t init;            // initialization segment the part is decoded with
+            Buffer data;
+            uint32_t duration;
+            bool independent;       // starts with a keyframe
+        };
+
+        Segmenter();
+        Segmenter( const Segmenter& orig ) = delete;
+        Segmenter &operator =( const Segmenter& orig ) = delete;
+        ~Segmenter();
+
+        // the stream thread, the same arguments as Recorder::store
+        void store( const Encoder::PS &sps,
+                    const Encoder::PS &pps,
+                    const uint8_t *data,
+                    size_t size,
+                    bool keyframe,
+                    int delay,
+                    int width,
+                    int height );
+
+        // eventfd signalled on every published part
+        int wakeup() const
+        {
+            return m_wakeup;
+        }
+        void notify();
+
+        // thread-safe. Pending - not there yet, but it is the next to come (a blocking request)
+        Status init( size_t id, Buffer &out );
+        // the playlist once the part (or with part < 0 the whole segment) msn is published, msn < 0 - right away
+        Status playlist( int64_t msn, int64_t part, Buffer &out );
+        Status segment( uint64_t msn, std::vector< Buffer > &out );
+        Status part( uint64_t msn, size_t index, Buffer &out );
+        // progressive fMP4: the parts published after seq, seq == 0 - from the last independent one
+        void fetch( uint64_t &seq, std::vector< Part > &parts );
+
+    private:
+        struct Segment
+        {
+            uint64_t msn;
+            size_t init;
+            bool discontinuity;     // the decode time starts over (a new initialization segment)
+            std::vector< Part > parts;
+            uint32_t duration {0};
+            bool complete {false};
+        };
+
+        int m_wakeup;
+
+        // the stream thread only
+        mp4::Muxer m_muxer;
+        Encoder::PS m_sps;
+        Encoder::PS m_pps;
+        int m_width {0};
+        int m_height {0};
+        std::vector< uint8_t > m_sample_data;
+        std::vector< mp4::Sample > m_samples;
+        uint32_t m_part_duration {0};
+        uint32_t m_segment_duration {0};
+        size_t m_gop_frames {0};            // between the last two keyframes, 0 - unknown
+        size_t m_since_keyframe {0};
+
+        std::mutex m_mutex;     // guards everything below
+        std::map< size_t, Buffer > m_inits;
+        size_t m_init {0};                  // id of the current initialization segment
+        bool m_discontinuity {false};       // the next segment follows a new initialization segment
+        std::deque< Segment > m_segments;
+        uint64_t m_msn {0};                 // media sequence number of the next segment
+        uint64_t m_seq {0};
+        uint64_t m_discontinuity_sequence {0};
+        Buffer m_playlist;
+
+    private:
+        void f_part( bool end_segment );
+        // the next segment or part to come: the open segment or the one after the last complete
+        uint64_t f_current() const;
+        const Segment *f_find( uint64_t msn ) const;
+        void f_playlist();
+    };
+
+}  // namespace http
+
+#endif /* HTTP_SEGMENTER_H */
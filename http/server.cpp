@@ -0,0 +1,508 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#include "server.h"
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+    std::string saddr2str( const sockaddr_in &addr )
+    {
+        char buf[INET_ADDRSTRLEN];
+        inet_ntop( AF_INET, &addr.sin_addr, buf, sizeof(buf) );
+        return std::string( buf ) + ":" + std::to_string( ntohs( addr.sin_port ) );
+    }
+
+    // value of a query parameter, -1 if there is none
+    int64_t query_value( const std::string &query, const char *name )
+    {
+        size_t len = strlen( name );
+        for( size_t pos = 0; pos < query.size(); )
+        {
+            size_t end = query.find( '&', pos );
+            if( end == std::string::npos )
+            {
+                end = query.size();
+            }
+            if( end - pos > len && !query.compare( pos, len, name ) && query[pos + len] == '=' )
+            {
+                return strtoll( query.c_str() + pos + len + 1, nullptr, 10 );
+            }
+            pos = end + 1;
+        }
+        return -1;
+    }
+
+    const char *PLAYLIST_TYPE = "application/vnd.apple.mpegurl";
+    const char *SEGMENT_TYPE = "video/iso.segment";
+    const char *MP4_TYPE = "video/mp4";
+    // a segment or a part never changes once published, a playlist changes with every part
+    const char *IMMUTABLE = "max-age=60";
+
+}  // namespace
+
+
+http::Server::Server( const Options &options, Segmenter &segmenter )
+: m_segmenter( segmenter )
+, m_socket( options.http_port )
+, m_fd( epoll_create1( EPOLL_CLOEXEC ) )
+{
+    if( m_fd == -1 )
+    {
+        throw std::runtime_error( std::string("[http] epoll_create failed: ") + strerror( errno ) );
+    }
+    try
+    {
+        f_add( m_socket );
+        f_add( m_segmenter.wakeup() );
+    }
+    catch( const std::runtime_error &err )
+    {
+        close( m_fd );
+        throw;
+    }
+}
+
+http::Server::~Server()
+{
+    for( auto &c : m_clients )
+    {
+        close( c.first );
+    }
+    close( m_fd );
+}
+
+void http::Server::stop()
+{
+    m_running.store( false );
+    m_segmenter.notify();
+}
+
+void http::Server::run()
+{
+    epoll_event events[maxevents];
+
+    while( m_running.load() )
+    {
+        // a blocking request that is not answered in time gets 503
+        int fd_count = epoll_wait( m_fd, events, maxevents, m_blocked ? 1000 : -1 );
+        for( int i(0); i < fd_count; ++i )
+        {
+            int fd = events[i].data.fd;
+            if( fd == m_socket )
+            {
+                f_accept();
+            }
+            else if( fd == m_segmenter.wakeup() )
+            {
+                uint64_t count;
+                while( ::read( fd, &count, sizeof(count) ) == -1 && errno == EINTR );
+                f_wakeup();
+            }
+            else
+            {
+                auto c = m_clients.find( fd );
+                if( c == m_clients.end() )
+                {
+                    continue;
+                }
+                Client &client = c->second;
+                bool closing = events[i].events & (EPOLLHUP | EPOLLERR);
+                if( !closing && (events[i].events & EPOLLIN) )
+                {
+                    // the requests sent before a half-close are still answered
+                    closing = !f_read( client );
+                    f_process( client );
+                }
+                closing = !f_flush( client ) || closing;
+                if( closing )
+                {
+                    f_close( fd );
+                }
+            }
+        }
+        if( m_blocked )
+        {
+            f_expire();
+        }
+    }
+}
+
+void http::Server::f_add( int fd )
+{
+    epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLET | EPOLLRDHUP;
+    ev.data.fd = fd;
+    if( epoll_ctl( m_fd, EPOLL_CTL_ADD, fd, &ev ) == -1 )
+    {
+        throw std::runtime_error( std::string("[http] epoll_ctl failed: ") + strerror( errno ) );
+    }
+}
+
+void http::Server::f_accept()
+{
+    while( true )
+    {
+        sockaddr_in address;
+        socklen_t socklen = sizeof(address);
+        int fd = accept4( m_socket, (sockaddr *)&address, &socklen, SOCK_NONBLOCK | SOCK_CLOEXEC );
+        if( fd == -1 )
+        {
+            if( errno == EINTR || errno == ECONNABORTED )
+            {
+                continue;
+            }
+            if( errno != EAGAIN && errno != EWOULDBLOCK )
+            {
+                std::cerr << "[http] accept4 failed: " << strerror( errno ) << std::endl;
+            }
+            break;
+        }
+        try
+        {
+            f_add( fd );
+        }
+        catch( const std::runtime_error &err )
+        {
+            std::cerr << err.what() << std::endl;
+            close( fd );
+            continue;
+        }
+        Client &client = m_clients[fd];
+        client.fd = fd;
+        client.address = address;
+    }
+}
+
+bool http::Server::f_read( Client &client )
+{
+    char buffer[4096];
+    while( true )
+    {
+        ssize_t rc = ::read( client.fd, buffer, sizeof(buffer) );
+        if( rc > 0 )
+        {
+            // the progressive stream does not take requests anymore
+            if( !client.progressive )
+            {
+                client.in.append( buffer, rc );
+            }
+            continue;
+        }
+        if( rc == 0 )
+        {
+            return false;
+        }
+        if( errno == EINTR )
+        {
+            continue;
+        }
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+}
+
+void http::Server::f_process( Client &client )
+{
+    while( client.keep_alive && client.blocked.empty() && !client.progressive )
+    {
+        size_t end = client.in.find( "\r\n\r\n" );
+        if( end == std::string::npos )
+        {
+            if( client.in.size() > MAX_REQUEST )
+            {
+                client.keep_alive = false;
+                f_reply( client, "431 Request Header Fields Too Large", "text/plain", {} );
+            }
+            break;
+        }
+        std::string request = client.in.substr( 0, end );
+        client.in.erase( 0, end + 4 );
+
+        char method[16], target[2048], version[16];
+        if( sscanf( request.c_str(), "%15s %2047s %15s", method, target, version ) != 3 )
+        {
+            client.keep_alive = false;
+            f_reply( client, "400 Bad Request", "text/plain", {} );
+            break;
+        }
+        std::transform( request.begin(), request.end(), request.begin(), ::tolower );
+        client.keep_alive = !strcmp( version, "HTTP/1.1" ) && request.find( "\nconnection: close" ) == std::string::npos;
+        client.head = !strcmp( method, "HEAD" );
+        if( strcmp( method, "GET" ) && !client.head )
+        {
+            f_reply( client, "405 Method Not Allowed", "text/plain", {} );
+            continue;
+        }
+        if( !f_respond( client, target ) )
+        {
+            client.blocked = target;
+            client.since = std::chrono::steady_clock::now();
+            ++m_blocked;
+        }
+    }
+}
+
+bool http::Server::f_respond( Client &client, const std::string &target )
+{
+    size_t q = target.find( '?' );
+    std::string path = target.substr( 0, q );
+    std::string query = q == std::string::npos ? std::string() : target.substr( q + 1 );
+
+    Segmenter::Status status = Segmenter::Status::Missing;
+    unsigned long long msn = 0;
+    size_t index = 0;
+    int n = -1;
+    if( path == "/" || path == "/live.m3u8" )
+    {
+        // blocking playlist reload: answered once the part asked for is there
+        int64_t hls_msn = query_value( query, "_HLS_msn" );
+        int64_t hls_part = query_value( query, "_HLS_part" );
+        Buffer playlist;
+        status = m_segmenter.playlist( hls_msn, hls_part, playlist );
+        if( status == Segmenter::Status::Ready )
+        {
+            f_reply( client, "200 OK", PLAYLIST_TYPE, { playlist }, hls_msn >= 0 ? IMMUTABLE : "no-cache" );
+        }
+        else if( status == Segmenter::Status::Missing )
+        {
+            f_reply( client, "400 Bad Request", "text/plain", {} );
+        }
+        return status != Segmenter::Status::Pending;
+    }
+    else if( sscanf( path.c_str(), "/init%zu.mp4%n", &index, &n ) == 1 && n == int(path.size()) )
+    {
+        Buffer init;
+        status = m_segmenter.init( index, init );
+        if( status == Segmenter::Status::Ready )
+        {
+            f_reply( client, "200 OK", MP4_TYPE, { init }, IMMUTABLE );
+        }
+    }
+    else if( sscanf( path.c_str(), "/seg%llu.m4s%n", &msn, &n ) == 1 && n == int(path.size()) )
+    {
+        std::vector< Buffer > parts;
+        status = m_segmenter.segment( msn, parts );
+        if( status == Segmenter::Status::Ready )
+        {
+            // the parts one after another are the segment, no copy
+            f_reply( client, "200 OK", SEGMENT_TYPE, parts, IMMUTABLE );
+        }
+    }
+    else if( sscanf( path.c_str(), "/part%llu.%zu.m4s%n", &msn, &index, &n ) == 2 && n == int(path.size()) )
+    {
+        Buffer part;
+        status = m_segmenter.part( msn, index, part );
+        if( status == Segmenter::Status::Ready )
+        {
+            f_reply( client, "200 OK", SEGMENT_TYPE, { part }, IMMUTABLE );
+        }
+    }
+    else if( path == "/stream.mp4" )
+    {
+        client.keep_alive = false;
+        std::string headers = std::string( "HTTP/1.1 200 OK\r\n"
+                                           "Content-Type: " ) + MP4_TYPE + "\r\n"
+                                           "Cache-Control: no-store\r\n"
+                                           "Access-Control-Allow-Origin: *\r\n"
+                                           "Connection: close\r\n\r\n";
+        client.queued += headers.size();
+        client.out.push_back( Chunk{ nullptr, std::move( headers ) } );
+        if( !client.head )
+        {
+            std::cerr << "[http] " << saddr2str( client.address ) << " progressive stream\n";
+            client.progressive = true;
+            f_progressive( client );
+        }
+        return true;
+    }
+
+    if( status == Segmenter::Status::Missing )
+    {
+        f_reply( client, "404 Not Found", "text/plain", {} );
+    }
+    return status != Segmenter::Status::Pending;
+}
+
+void http::Server::f_reply( Client &client, const char *status, const char *type, const std::vector< Buffer > &body, const char *cache )
+{
+    size_t length = 0;
+    for( const auto &b : body )
+    {
+        length += b->size();
+    }
+    std::string headers = std::string( "HTTP/1.1 " ) + status + "\r\n"
+                          "Content-Type: " + type + "\r\n"
+                          "Content-Length: " + std::to_string( length ) + "\r\n"
+                          "Cache-Control: " + cache + "\r\n"
+                          "Access-Control-Allow-Origin: *\r\n" +
+                          (client.keep_alive ? "" : "Connection: close\r\n") + "\r\n";
+    client.queued += headers.size();
+    client.out.push_back( Chunk{ nullptr, std::move( headers ) } );
+    if( client.head )
+    {
+        return;
+    }
+    for( const auto &b : body )
+    {
+        client.queued += b->size();
+        client.out.push_back( Chunk{ b, std::string() } );
+    }
+}
+
+void http::Server::f_progressive( Client &client )
+{
+    std::vector< Segmenter::Part > parts;
+    m_segmenter.fetch( client.seq, parts );
+    for( const auto &p : parts )
+    {
+        if( p.init != client.init )
+        {
+            Buffer init;
+            if( client.init || m_segmenter.init( p.init, init ) != Segmenter::Status::Ready )
+            {
+                // the picture size has changed: the stream ends, the player reconnects
+                client.progressive = false;
+                return;
+            }
+            client.init = p.init;
+            client.queued += init->size();
+            client.out.push_back( Chunk{ init, std::string() } );
+        }
+        client.queued += p.data->size();
+        client.out.push_back( Chunk{ p.data, std::string() } );
+    }
+}
+
+void http::Server::f_wakeup()
+{
+    std::vector< int > closed;
+    for( auto &c : m_clients )
+    {
+        Client &client = c.second;
+        if( client.progressive )
+        {
+            f_progressive( client );
+            if( client.queued > MAX_QUEUED_BYTES )
+            {
+                std::cerr << "[http] " << saddr2str( client.address ) << " does not keep up with the stream\n";
+                closed.push_back( c.first );
+                continue;
+            }
+        }
+        else if( !client.blocked.empty() && f_respond( client, client.blocked ) )
+        {
+            client.blocked.clear();
+            --m_blocked;
+            f_process( client );
+        }
+        if( !f_flush( client ) )
+        {
+            closed.push_back( c.first );
+        }
+    }
+    for( int fd : closed )
+    {
+        f_close( fd );
+    }
+}
+
+void http::Server::f_expire()
+{
+    auto now = std::chrono::steady_clock::now();
+    std::vector< int > closed;
+    for( auto &c : m_clients )
+    {
+        Client &client = c.second;
+        if( client.blocked.empty() || now - client.since < BLOCK_TIMEOUT )
+        {
+            continue;
+        }
+        client.blocked.clear();
+        --m_blocked;
+        f_reply( client, "503 Service Unavailable", "text/plain", {} );
+        f_process( client );
+        if( !f_flush( client ) )
+        {
+            closed.push_back( c.first );
+        }
+    }
+    for( int fd : closed )
+    {
+        f_close( fd );
+    }
+}
+
+bool http::Server::f_flush( Client &client )
+{
+    while( !client.out.empty() )
+    {
+        iovec iov[MAX_IOV];
+        size_t count = 0;
+        for( auto i = client.out.begin(); i != client.out.end() && count < MAX_IOV; ++i, ++count )
+        {
+            const uint8_t *data = i->buffer ? i->buffer->data() : (const uint8_t *)i->text.data();
+            size_t size = i->buffer ? i->buffer->size() : i->text.size();
+            iov[count].iov_base = (void *)(data + i->offset);
+            iov[count].iov_len = size - i->offset;
+        }
+        msghdr msg {};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        ssize_t rc = ::sendmsg( client.fd, &msg, MSG_NOSIGNAL );
+        if( rc < 0 )
+        {
+            if( errno == EINTR )
+            {
+                continue;
+            }
+            // EAGAIN: the rest goes on EPOLLOUT
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        client.queued -= rc;
+        for( size_t i = 0; i < count && rc > 0; ++i )
+        {
+            size_t left = iov[i].iov_len;
+            if( size_t(rc) < left )
+            {
+                client.out.front().offset += rc;
+                break;
+            }
+            rc -= left;
+            client.out.pop_front();
+        }
+    }
+    // a response with "Connection: close" or the end of the progressive stream
+    return client.keep_alive || client.progressive || !client.blocked.empty();
+}
+
+void http::Server::f_close( int fd )
+{
+    auto c = m_clients.find( fd );
+    if( c == m_clients.end() )
+    {
+        return;
+    }
+    if( !c->second.blocked.empty() )
+    {
+        --m_blocked;
+    }
+    if( c->second.progressive )
+    {
+        std::cerr << "[http] " << saddr2str( c->second.address ) << " progressive stream closed\n";
+    }
+    epoll_ctl( m_fd, EPOLL_CTL_DEL, fd, nullptr );
+    close( fd );
+    m_clients.erase( c );
+}
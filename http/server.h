@@ -0,0 +1,93 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#ifndef HTTP_SERVER_H
+#define HTTP_SERVER_H
+
+#include "segmenter.h"
+#include "../options.h"
+#include "../rtsp/socket.h"
+#include <netinet/in.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace http {
+
+    // HTTP/1.1 egress of the stream on its own thread: the LL-HLS playlist (blocking reload
+    // with _HLS_msn/_HLS_part), its segments and partial segments, and progressive fMP4.
+    // Every body is a list of the segmenter's shared buffers written with writev, nothing is
+    // muxed or copied per client, so a caching proxy in front of it serves any number of viewers
+    class Server {
+    public:
+        static const size_t MAX_REQUEST = 8192;
+        // a progressive client that far behind is dropped
+        static const size_t MAX_QUEUED_BYTES = 8 * 1024 * 1024;
+        // a blocking request is answered with 503 after that (three target durations)
+        static constexpr std::chrono::seconds BLOCK_TIMEOUT { 3 * Segmenter::SEGMENT_MAX / mp4::Muxer::TIMESCALE };
+
+        Server( const Options &options, Segmenter &segmenter );
+        Server( const Server& orig ) = delete;
+        Server &operator =( const Server& orig ) = delete;
+        ~Server();
+
+        void run();
+        void stop();
+
+    private:
+        enum { maxevents = 32, MAX_IOV = 64 };
+
+        struct Chunk
+        {
+            Buffer buffer;          // or the headers of a response
+            std::string text;
+            size_t offset {0};
+        };
+
+        struct Client
+        {
+            int fd;
+            sockaddr_in address;
+            std::string in;
+            std::deque< Chunk > out;
+            size_t queued {0};
+            bool keep_alive {true};
+            bool head {false};              // HEAD: the headers only
+            std::string blocked;            // target of the request waiting for the segmenter
+            std::chrono::steady_clock::time_point since;
+            bool progressive {false};
+            uint64_t seq {0};               // the last part sent to the progressive client
+            size_t init {0};
+        };
+
+        std::atomic< bool > m_running { true };
+        Segmenter &m_segmenter;
+        rtsp::Socket m_socket;
+        int m_fd;
+        std::unordered_map< int, Client > m_clients;
+        size_t m_blocked {0};
+
+    private:
+        void f_add( int fd );
+        void f_accept();
+        // reads the requests, false - the client has gone
+        bool f_read( Client &client );
+        void f_process( Client &client );
+        // false - the resource is not there yet, the request waits
+        bool f_respond( Client &client, const std::string &target );
+        void f_reply( Client &client, const char *status, const char *type, const std::vector< Buffer > &body,
+                      const char *cache = "no-cache" );
+        void f_progressive( Client &client );
+        void f_wakeup();
+        void f_expire();
+        bool f_flush( Client &client );
+        void f_close( int fd );
+    };
+
+}  // namespace http
+
+#endif /* HTTP_SERVER_H */
@@ -0,0 +1,176 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#include "jpegencoder.h"
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+    const uint8_t SOI = 0xd8;
+    const uint8_t EOI = 0xd9;
+    const uint8_t SOF0 = 0xc0;
+    const uint8_t DHT = 0xc4;
+    const uint8_t DQT = 0xdb;
+    const uint8_t DRI = 0xdd;
+    const uint8_t SOS = 0xda;
+    const uint8_t RST0 = 0xd0;
+
+    struct Segment
+    {
+        const uchar *ptr;
+        size_t size;
+    };
+
+    // walks the marker segments up to the entropy-coded data, returns its offset or 0
+    size_t parse( const std::vector< uchar > &jpg, std::vector< Segment > *segments )
+    {
+        size_t off = 2;
+        while( off + 4 <= jpg.size() )
+        {
+            if( jpg[off] != 0xff )
+            {
+                return 0;
+            }
+            uint8_t marker = jpg[off + 1];
+            size_t len = (size_t(jpg[off + 2]) << 8) | jpg[off + 3];
+            if( segments )
+            {
+                segments->push_back( Segment{ &jpg[off], len + 2 } );
+            }
+            off += len + 2;
+            if( marker == SOS )
+            {
+                return off <= jpg.size() ? off : 0;
+            }
+        }
+        return 0;
+    }
+
+}  // namespace
+
+
+JpegEncoder::JpegEncoder( uint32_t width, uint32_t height, int quality, int strips, bool restart )
+: m_quality( quality )
+, m_strips( strips > 0 ? strips : std::max( cv::getNumThreads(), 1 ) )
+, m_restart( restart )
+{
+    double scale = std::min( 1.0, double(MAX_SIDE) / std::max( width, height ) );
+    m_scaled_size = cv::Size( width * scale, height * scale );
+    m_frame_size = cv::Size( m_scaled_size.width & ~7, m_scaled_size.height & ~7 );
+    if( !m_frame_size.area() )
+    {
+        throw std::logic_error( "[jpeg_enc] frame is too small" );
+    }
+    m_keyframe = true;
+}
+
+void JpegEncoder::encode( const cv::Mat &rgb, int delay, Encoder::PS *sps, Encoder::PS *pps )
+{
+    cv::Mat src = rgb;
+    if( rgb.size() != m_scaled_size )
+    {
+        cv::resize( rgb, m_scaled, m_scaled_size, 0, 0, cv::INTER_AREA );
+        src = m_scaled;
+    }
+    src = src( cv::Rect( 0, 0, m_frame_size.width, m_frame_size.height ) );
+
+    int mcu_rows = (m_frame_size.height + 15) / 16;
+    int strip_height = (mcu_rows + std::min( m_strips, mcu_rows ) - 1) / std::min( m_strips, mcu_rows ) * 16;
+    int strips = (m_frame_size.height + strip_height - 1) / strip_height;
+    int restart_interval = (m_restart || strips > 1) ? (m_frame_size.width + 15) / 16 : 0;
+
+    std::vector< int > params { cv::IMWRITE_JPEG_QUALITY, m_quality };
+    if( restart_interval )
+    {
+        params.push_back( cv::IMWRITE_JPEG_RST_INTERVAL );
+        params.push_back( restart_interval );
+    }
+
+    m_strip_data.resize( strips );
+    cv::parallel_for_( cv::Range( 0, strips ), [&]( const cv::Range &range ) {
+        for( int i = range.start; i < range.end; ++i )
+        {
+            int y = i * strip_height;
+            cv::Rect roi( 0, y, src.cols, std::min( strip_height, src.rows - y ) );
+            cv::imencode( ".jpg", src( roi ), m_strip_data[i], params );
+        }
+    } );
+
+    f_assemble( restart_interval );
+    m_data = m_frame.data();
+    m_size = m_frame.size();
+}
+
+void JpegEncoder::store( std::ofstream &f )
+{
+    f.write( (const char *)m_frame.data(), m_frame.size() );
+}
+
+void JpegEncoder::f_assemble( int restart_interval )
+{
+    std::vector< Segment > segments;
+    size_t scan = parse( m_strip_data[0], &segments );
+    if( !scan )
+    {
+        throw std::runtime_error( "[jpeg_enc] malformed strip" );
+    }
+
+    m_frame.assign( { 0xff, SOI } );
+    for( const auto &s : segments )
+    {
+        uint8_t marker = s.ptr[1];
+        if( marker == SOS && restart_interval )
+        {
+            m_frame.insert( m_frame.end(), { 0xff, DRI, 0, 4, uint8_t(restart_interval >> 8), uint8_t(restart_interval) } );
+        }
+        if( marker == DQT || marker == SOF0 || marker == DHT || marker == SOS )
+        {
+            size_t off = m_frame.size();
+            m_frame.insert( m_frame.end(), s.ptr, s.ptr + s.size );
+            if( marker == SOF0 )
+            {
+                // the strip knows only its own height
+                m_frame[off + 5] = m_frame_size.height >> 8;
+                m_frame[off + 6] = m_frame_size.height;
+            }
+        }
+    }
+
+    uint8_t rst = 0;
+    for( size_t i(0); i < m_strip_data.size(); ++i )
+    {
+        const auto &strip = m_strip_data[i];
+        size_t begin = i ? parse( strip, nullptr ) : scan;
+        if( !begin || strip.size() < begin + 2 )
+        {
+            throw std::runtime_error( "[jpeg_enc] malformed strip" );
+        }
+
+        size_t off = m_frame.size();
+        m_frame.insert( m_frame.end(), strip.begin() + begin, strip.end() - 2 );  // without EOI
+        if( !restart_interval )
+        {
+            continue;
+        }
+        // restart markers of every strip start from RST0 - renumber them for the whole frame
+        for( size_t k(off); k + 1 < m_frame.size(); ++k )
+        {
+            if( m_frame[k] == 0xff && (m_frame[k + 1] & 0xf8) == RST0 )
+            {
+                m_frame[++k] = RST0 | (rst++ & 0x07);
+            }
+        }
+        if( i + 1 < m_strip_data.size() )
+        {
+            m_frame.push_back( 0xff );
+            m_frame.push_back( RST0 | (rst++ & 0x07) );
+        }
+    }
+    m_frame.push_back( 0xff );
+    m_frame.push_back( EOI );
+}
@@ -0,0 +1,38 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#ifndef VIDEODEFECTS_JPEGENCODER_H
+#define VIDEODEFECTS_JPEGENCODER_H
+
+#include "encoder.h"
+
+// Baseline JPEG suitable for RTP/JPEG (RFC 2435). The frame is cut into horizontal
+// strips of whole MCU rows that are encoded in parallel and stitched back into one
+// scan with restart markers between the strips.
+class JpegEncoder: public Encoder::Backend {
+public:
+    static const int MAX_SIDE = 2040;   // RFC 2435 keeps width/8 and height/8 in one octet
+
+    JpegEncoder( uint32_t width, uint32_t height, int quality, int strips, bool restart );
+
+    void encode( const cv::Mat &rgb, int delay, Encoder::PS *sps, Encoder::PS *pps ) override;
+    void store( std::ofstream &f ) override;
+
+private:
+    cv::Size m_scaled_size;
+    cv::Size m_frame_size;
+    int m_quality;
+    int m_strips;
+    bool m_restart;
+
+    cv::Mat m_scaled;
+    std::vector< std::vector< uchar > > m_strip_data;
+    std::vector< uint8_t > m_frame;
+
+private:
+    void f_assemble( int restart_interval );
+};
+
+
+#endif //VIDEODEFECTS_JPEGENCODER_H
@@ -1,6 +1,17 @@
+#include "framepool.h"
 #include "reader.h"
 #include "window.h"
+#include "options.h"
+#include "recorder.h"
+#include "rtsp/impairment.h"
 #include <getopt.h>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 
 namespace
@@ -26,20 +37,74 @@ namespace
 
     void show_options_and_exit( const char *prog, int rc )
     {
-        std::cerr << "Запуск: " << prog <<  "[-s] [-c] [-v] [-h]\n\n";
+        std::cerr << "Запуск: " << prog <<  "[-s] [-c] [-n] [-i] [-z] [-u] [-N] [-t] [-K] [-H] [-a] [-A] [-k] [-e] [-B] [-M] [-U] [-I] [-q] [-j] [-m] [-r] [-R] [-S] [-T] [-g] [-P] [-x] [-C] [-W] [-F] [-v] [-h]\n\n";
         std::cerr << "\t-f\tфайл на воспроизведение\n";
         std::cerr << "\t-c\tкамера на воспроизведение (int)\n";
+        std::cerr << "\t-n\tчисло циклов обработки rtsp-соединений, каждый на своем ядре (по умолчанию 1)\n";
+        std::cerr << "\t-i\tсетевой ввод-вывод через io_uring вместо epoll (сборка с -DWITH_IO_URING=ON)\n";
+        std::cerr << "\t-z\tотправка по tcp без копирования (MSG_ZEROCOPY) для записей от указанного размера (Кб)\n";
+        std::cerr << "\t-u\tudp порт выдачи rtp (rtcp - следующий порт), 0 - только tcp (по умолчанию 6970)\n";
+        std::cerr << "\t-N\tэмуляция сети для rtp по udp: loss=%,burst=вход%:выход%,delay=мс,jitter=мс,reorder=%,dup=%,rate=кбит/с,seed=n\n";
+        std::cerr << "\t-t\trtsps: файл сертификата (PEM), шифрование в ядре через kTLS (сборка с -DWITH_TLS=ON)\n";
+        std::cerr << "\t-K\tфайл закрытого ключа для -t (по умолчанию ключ в файле сертификата)\n";
+        std::cerr << "\t-H\thttp порт выдачи fmp4 (/stream.mp4) и ll-hls (/live.m3u8), только h264\n";
+        std::cerr << "\t-a\tmulticast-группа выдачи: адрес[:порт[:ttl]] (по умолчанию порт 5004, ttl 1)\n";
+        std::cerr << "\t-A\tадрес интерфейса для multicast (например 127.0.0.1)\n";
+        std::cerr << "\t-k\tзапрашивать ключевой кадр у кодера при подключении клиента\n";
+        std::cerr << "\t-e\tкодек выдаваемого потока: h264 или jpeg (по умолчанию h264)\n";
+        std::cerr << "\t-B\tпостоянный битрейт h264 (кбит/с), по умолчанию CRF 23\n";
+        std::cerr << "\t-M\tмаксимальный битрейт VBV (кбит/с), по умолчанию равен -B\n";
+        std::cerr << "\t-U\tразмер буфера VBV (кбит), по умолчанию два кадра на максимальном битрейте\n";
+        std::cerr << "\t-I\tпериодический intra refresh вместо IDR-кадров\n";
+        std::cerr << "\t-q\tкачество jpeg (1-100, по умолчанию 80)\n";
+        std::cerr << "\t-j\tчисло полос параллельного кодирования jpeg (по умолчанию по числу потоков OpenCV)\n";
+        std::cerr << "\t-m\tjpeg с restart-маркерами после каждой строки MCU\n";
+        std::cerr << "\t-r\tпрефикс имени файлов записи выдаваемого потока\n";
+        std::cerr << "\t-R\tформаты записи: h264, mp4 или h264,mp4 (по умолчанию h264)\n";
+        std::cerr << "\t-S\tротация файлов записи по размеру (Мб)\n";
+        std::cerr << "\t-T\tротация файлов записи по времени (сек)\n";
+        std::cerr << "\t-g\tадаптивное снижение нагрузки при нехватке времени на кадр\n";
+        std::cerr << "\t-P\tпул буферов кадров: off, on или huge,numa (огромные страницы, память узла NUMA), по умолчанию on\n";
+        std::cerr << "\t-x\tбез окна предпросмотра (сервер без дисплея), дефекты управляются через -C\n";
+        std::cerr << "\t-C\tudp канал управления дефектами: [адрес:]порт (по умолчанию адрес 127.0.0.1)\n";
+        std::cerr << "\t-W\tширина окна предпросмотра, более широкие кадры уменьшаются (по умолчанию 1280), 0 - исходный размер\n";
+        std::cerr << "\t-F\tчастота кадров предпросмотра, 0 - каждый кадр (по умолчанию)\n";
         std::cerr << "\t-v\tвывод клавиш управления\n";
         std::cerr << "\t-h\tвывод параметров запуска\n";
         ::exit( rc );
     }
+
+    // the whole argument is an integer within [min, max], otherwise the usage and exit
+    long integer_arg( const char *prog, const char *arg, long min, long max )
+    {
+        char *end = nullptr;
+        errno = 0;
+        long value = strtol( arg, &end, 10 );
+        if( !*arg || *end || errno || value < min || value > max )
+        {
+            show_options_and_exit( prog, EXIT_FAILURE );
+        }
+        return value;
+    }
+
+    double real_arg( const char *prog, const char *arg, double min )
+    {
+        char *end = nullptr;
+        double value = strtod( arg, &end );
+        if( !*arg || *end || !std::isfinite( value ) || value < min )
+        {
+            show_options_and_exit( prog, EXIT_FAILURE );
+        }
+        return value;
+    }
 }
 
 int main( int argc, char *argv[]) {
 
     const char *src = nullptr;
+    Options options;
     int c;
-    while ((c = getopt (argc, argv, "f:c:vh")) != -1)
+    while ((c = getopt (argc, argv, "f:c:n:iz:u:N:t:K:H:a:A:ke:B:M:U:Iq:j:mr:R:S:T:gP:xC:W:F:vh")) != -1)
     {
         switch (c)
         {
@@ -53,6 +118,144 @@ int main( int argc, char *argv[]) {
             }
             src = optarg;
             break;
+        case 'n':
+            options.loops = integer_arg( argv[0], optarg, 1, INT_MAX );
+            break;
+        case 'i':
+            options.io_uring = true;
+            break;
+        case 'z':
+            options.zerocopy = integer_arg( argv[0], optarg, 0, LONG_MAX / 1024 ) * 1024;
+            break;
+        case 'u':
+            // RTCP goes over the next port, 0 - tcp only
+            options.rtp_port = integer_arg( argv[0], optarg, 0, 0xfffe );
+            break;
+        case 'N':
+            if( !rtsp::Impairment::Profile().parse( optarg ) )
+            {
+                show_options_and_exit( argv[0], EXIT_FAILURE );
+            }
+            options.impairment = optarg;
+            break;
+        case 't':
+#ifndef WITH_TLS
+            // no fallback to plain rtsp when encryption is asked for
+            std::cerr << "[-] built without tls, rebuild with -DWITH_TLS=ON\n";
+            ::exit( EXIT_FAILURE );
+#endif
+            options.tls_cert = optarg;
+            break;
+        case 'K':
+            options.tls_key = optarg;
+            break;
+        case 'H':
+            options.http_port = integer_arg( argv[0], optarg, 1, 0xffff );
+            break;
+        case 'a':
+        {
+            unsigned port = options.multicast_port, ttl = options.multicast_ttl;
+            char group[INET_ADDRSTRLEN] = { 0 };
+            if( sscanf( optarg, "%15[0-9.]:%u:%u", group, &port, &ttl ) < 1 || !port || port > 0xffff || !ttl || ttl > 255 )
+            {
+                show_options_and_exit( argv[0], EXIT_FAILURE );
+            }
+            options.multicast = group;
+            options.multicast_port = port;
+            options.multicast_ttl = ttl;
+            break;
+        }
+        case 'A':
+            options.multicast_if = optarg;
+            break;
+        case 'k':
+            options.keyframe_on_join = true;
+            break;
+        case 'e':
+            if( !strcmp( optarg, "jpeg" ) )
+            {
+                options.codec = Codec::JPEG;
+            }
+            else if( strcmp( optarg, "h264" ) )
+            {
+                show_options_and_exit( argv[0], EXIT_FAILURE );
+            }
+            break;
+        case 'B':
+            options.bitrate = integer_arg( argv[0], optarg, 0, INT_MAX );
+            break;
+        case 'M':
+            options.vbv_maxrate = integer_arg( argv[0], optarg, 0, INT_MAX );
+            break;
+        case 'U':
+            options.vbv_bufsize = integer_arg( argv[0], optarg, 0, INT_MAX );
+            break;
+        case 'I':
+            options.intra_refresh = true;
+            break;
+        case 'q':
+            options.jpeg_quality = integer_arg( argv[0], optarg, 1, 100 );
+            break;
+        case 'j':
+            options.jpeg_strips = integer_arg( argv[0], optarg, 0, INT_MAX );
+            break;
+        case 'm':
+            options.jpeg_restart = true;
+            break;
+        case 'r':
+            options.record = optarg;
+            break;
+        case 'R':
+            options.record_formats = 0;
+            if( strstr( optarg, "h264" ) )
+            {
+                options.record_formats |= Recorder::Format::AnnexB;
+            }
+            if( strstr( optarg, "mp4" ) )
+            {
+                options.record_formats |= Recorder::Format::MP4;
+            }
+            if( !options.record_formats )
+            {
+                show_options_and_exit( argv[0], EXIT_FAILURE );
+            }
+            break;
+        case 'S':
+            options.record_size = integer_arg( argv[0], optarg, 0, LONG_MAX >> 20 ) << 20;
+            break;
+        case 'T':
+            options.record_duration = integer_arg( argv[0], optarg, 0, INT_MAX );
+            break;
+        case 'g':
+            options.governor = true;
+            break;
+        case 'P':
+            options.frame_pool = strstr( optarg, "off" ) ? 0 : FramePool::Enabled;
+            if( strstr( optarg, "huge" ) )
+            {
+                options.frame_pool |= FramePool::HugePages;
+            }
+            if( strstr( optarg, "numa" ) )
+            {
+                options.frame_pool |= FramePool::Numa;
+            }
+            if( options.frame_pool == FramePool::Enabled && !strstr( optarg, "on" ) )
+            {
+                show_options_and_exit( argv[0], EXIT_FAILURE );
+            }
+            break;
+        case 'x':
+            options.headless = true;
+            break;
+        case 'C':
+            options.control = optarg;
+            break;
+        case 'W':
+            options.preview_width = integer_arg( argv[0], optarg, 0, INT_MAX );
+            break;
+        case 'F':
+            options.preview_fps = real_arg( argv[0], optarg, 0. );
+            break;
         case 'v':
             show_api_keys_and_exit( argv[0], EXIT_SUCCESS );
             break;
@@ -66,6 +269,13 @@ int main( int argc, char *argv[]) {
         show_options_and_exit( argv[0], EXIT_FAILURE );
     }
 
+    // a client gone in the middle of a write is an EPIPE of that connection, not the end of the
+    // process: the TLS handshake is written by OpenSSL with a plain write()
+    signal( SIGPIPE, SIG_IGN );
+
+    // before the first frame is decoded: every frame buffer comes from the pool
+    FramePool *pool = FramePool::install( options.frame_pool );
+
     try {
         Reader r;
         if( std::isdigit( src[0] ) ) {
@@ -75,12 +285,18 @@ int main( int argc, char *argv[]) {
             r.open( src );
         }
 
-        Window( src ).run( r );
+        Window( src, options ).run( r );
     }
     catch( const std::exception & e ) {
         std::cerr << e.what() << std::endl;
         return EXIT_FAILURE;
     }
 
+    if( pool )
+    {
+        FramePool::Stats st = pool->stats();
+        std::cerr << "[*] frame pool: " << st.hits << " hits, " << st.misses << " misses, "
+                  << st.unmapped << " unmapped, " << (st.mapped >> 20) << " Mb mapped\n";
+    }
     return EXIT_SUCCESS;
 }
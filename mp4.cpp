@@ -0,0 +1,255 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#include "mp4.h"
+#include <cstring>
+
+namespace {
+
+    void put8( std::vector< uint8_t > &out, uint8_t v )
+    {
+        out.push_back( v );
+    }
+    void put16( std::vector< uint8_t > &out, uint16_t v )
+    {
+        out.push_back( v >> 8 );
+        out.push_back( v );
+    }
+    void put32( std::vector< uint8_t > &out, uint32_t v )
+    {
+        put16( out, v >> 16 );
+        put16( out, v );
+    }
+    void put64( std::vector< uint8_t > &out, uint64_t v )
+    {
+        put32( out, v >> 32 );
+        put32( out, v );
+    }
+    void put( std::vector< uint8_t > &out, const void *data, size_t size )
+    {
+        const uint8_t *p = (const uint8_t *)data;
+        out.insert( out.end(), p, p + size );
+    }
+    void zeros( std::vector< uint8_t > &out, size_t count )
+    {
+        out.insert( out.end(), count, 0 );
+    }
+    void matrix( std::vector< uint8_t > &out )
+    {
+        static const uint32_t unity[9] = { 0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000 };
+        for( uint32_t v : unity )
+        {
+            put32( out, v );
+        }
+    }
+
+    const uint32_t TRACK_ID = 1;
+    const uint32_t KEY_SAMPLE_FLAGS = 0x02000000;      // sample_depends_on = 2 (I-frame)
+    const uint32_t NON_KEY_SAMPLE_FLAGS = 0x01010000;  // sample_depends_on = 1, non-sync sample
+
+}  // namespace
+
+
+mp4::Box::Box( std::vector< uint8_t > &out, const char *type, int version, uint32_t flags )
+: m_out( out )
+, m_offset( out.size() )
+{
+    put32( m_out, 0 );
+    put( m_out, type, 4 );
+    if( version >= 0 )
+    {
+        put32( m_out, (uint32_t(version) << 24) | (flags & 0xffffff) );
+    }
+}
+
+mp4::Box::~Box()
+{
+    uint32_t size = m_out.size() - m_offset;
+    m_out[m_offset] = size >> 24;
+    m_out[m_offset + 1] = size >> 16;
+    m_out[m_offset + 2] = size >> 8;
+    m_out[m_offset + 3] = size;
+}
+
+
+void mp4::Muxer::init( std::vector< uint8_t > &out,
+                       const std::vector< uint8_t > &sps,
+                       const std::vector< uint8_t > &pps,
+                       uint16_t width,
+                       uint16_t height )
+{
+    m_sequence = 0;
+    m_decode_time = 0;
+    {
+        Box ftyp( out, "ftyp" );
+        put( out, "iso5", 4 );
+        put32( out, 512 );
+        put( out, "iso5iso6mp41avc1", 16 );
+    }
+    Box moov( out, "moov" );
+    {
+        Box mvhd( out, "mvhd", 0 );
+        put32( out, 0 );          // creation time
+        put32( out, 0 );          // modification time
+        put32( out, TIMESCALE );
+        put32( out, 0 );          // duration
+        put32( out, 0x00010000 ); // rate
+        put16( out, 0x0100 );     // volume
+        zeros( out, 10 );
+        matrix( out );
+        zeros( out, 24 );
+        put32( out, TRACK_ID + 1 );
+    }
+    {
+        Box trak( out, "trak" );
+        {
+            Box tkhd( out, "tkhd", 0, 0x000003 );
+            put32( out, 0 );
+            put32( out, 0 );
+            put32( out, TRACK_ID );
+            put32( out, 0 );
+            put32( out, 0 );          // duration
+            zeros( out, 8 );
+            put16( out, 0 );          // layer
+            put16( out, 0 );          // alternate group
+            put16( out, 0 );          // volume
+            put16( out, 0 );
+            matrix( out );
+            put32( out, uint32_t(width) << 16 );
+            put32( out, uint32_t(height) << 16 );
+        }
+        Box mdia( out, "mdia" );
+        {
+            Box mdhd( out, "mdhd", 0 );
+            put32( out, 0 );
+            put32( out, 0 );
+            put32( out, TIMESCALE );
+            put32( out, 0 );
+            put16( out, 0x55c4 );     // 'und'
+            put16( out, 0 );
+        }
+        {
+            Box hdlr( out, "hdlr", 0 );
+            put32( out, 0 );
+            put( out, "vide", 4 );
+            zeros( out, 12 );
+            put( out, "VideoHandler", 13 );
+        }
+        Box minf( out, "minf" );
+        {
+            Box vmhd( out, "vmhd", 0, 0x000001 );
+            zeros( out, 8 );
+        }
+        {
+            Box dinf( out, "dinf" );
+            Box dref( out, "dref", 0 );
+            put32( out, 1 );
+            Box url( out, "url ", 0, 0x000001 );
+        }
+        Box stbl( out, "stbl" );
+        {
+            Box stsd( out, "stsd", 0 );
+            put32( out, 1 );
+            Box avc1( out, "avc1" );
+            zeros( out, 6 );
+            put16( out, 1 );          // data reference index
+            zeros( out, 16 );
+            put16( out, width );
+            put16( out, height );
+            put32( out, 0x00480000 ); // 72 dpi
+            put32( out, 0x00480000 );
+            put32( out, 0 );
+            put16( out, 1 );          // frame count
+            zeros( out, 32 );         // compressor name
+            put16( out, 0x0018 );
+            put16( out, 0xffff );
+            Box avcC( out, "avcC" );
+            put8( out, 1 );
+            put8( out, sps.size() > 1 ? sps[1] : 0 );
+            put8( out, sps.size() > 2 ? sps[2] : 0 );
+            put8( out, sps.size() > 3 ? sps[3] : 0 );
+            put8( out, 0xff );        // 4-byte NAL unit lengths
+            put8( out, 0xe1 );        // one SPS
+            put16( out, sps.size() );
+            put( out, sps.data(), sps.size() );
+            put8( out, 1 );           // one PPS
+            put16( out, pps.size() );
+            put( out, pps.data(), pps.size() );
+        }
+        {
+            Box stts( out, "stts", 0 );
+            put32( out, 0 );
+        }
+        {
+            Box stsc( out, "stsc", 0 );
+            put32( out, 0 );
+        }
+        {
+            Box stsz( out, "stsz", 0 );
+            put32( out, 0 );
+            put32( out, 0 );
+        }
+        {
+            Box stco( out, "stco", 0 );
+            put32( out, 0 );
+        }
+    }
+    Box mvex( out, "mvex" );
+    Box trex( out, "trex", 0 );
+    put32( out, TRACK_ID );
+    put32( out, 1 );                  // default sample description index
+    put32( out, 0 );
+    put32( out, 0 );
+    put32( out, 0 );
+}
+
+void mp4::Muxer::fragment( std::vector< uint8_t > &out, const std::vector< Sample > &samples )
+{
+    if( samples.empty() )
+    {
+        return;
+    }
+
+    size_t moof_offset = out.size();
+    size_t data_offset_pos = 0;
+    {
+        Box moof( out, "moof" );
+        {
+            Box mfhd( out, "mfhd", 0 );
+            put32( out, ++m_sequence );
+        }
+        Box traf( out, "traf" );
+        {
+            Box tfhd( out, "tfhd", 0, 0x020000 ); // default-base-is-moof
+            put32( out, TRACK_ID );
+        }
+        {
+            Box tfdt( out, "tfdt", 1 );
+            put64( out, m_decode_time );
+        }
+        Box trun( out, "trun", 0, 0x000701 );     // data offset, sample duration, size and flags
+        put32( out, samples.size() );
+        data_offset_pos = out.size();
+        put32( out, 0 );
+        for( const auto &s : samples )
+        {
+            put32( out, s.duration );
+            put32( out, s.size );
+            put32( out, s.keyframe ? KEY_SAMPLE_FLAGS : NON_KEY_SAMPLE_FLAGS );
+            m_decode_time += s.duration;
+        }
+    }
+
+    uint32_t data_offset = out.size() - moof_offset + 8;
+    out[data_offset_pos] = data_offset >> 24;
+    out[data_offset_pos + 1] = data_offset >> 16;
+    out[data_offset_pos + 2] = data_offset >> 8;
+    out[data_offset_pos + 3] = data_offset;
+
+    Box mdat( out, "mdat" );
+    for( const auto &s : samples )
+    {
+        put( out, s.data, s.size );
+    }
+}
@@ -0,0 +1,65 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#ifndef VIDEODEFECTS_MP4_H
+#define VIDEODEFECTS_MP4_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mp4 {
+
+    class Box {
+    public:
+        Box( std::vector< uint8_t > &out, const char *type, int version = -1, uint32_t flags = 0 );
+        ~Box();
+
+        Box( const Box& orig ) = delete;
+        Box &operator =( const Box& orig ) = delete;
+
+    private:
+        std::vector< uint8_t > &m_out;
+        size_t m_offset;
+    };
+
+    // sample in AVCC form: NAL units each prefixed with a 4-byte length
+    struct Sample
+    {
+        const uint8_t *data;
+        uint32_t size;
+        uint32_t duration;
+        bool keyframe;
+    };
+
+    class Muxer {
+    public:
+        static const uint32_t TIMESCALE = 90000;
+
+        void init( std::vector< uint8_t > &out,
+                   const std::vector< uint8_t > &sps,
+                   const std::vector< uint8_t > &pps,
+                   uint16_t width,
+                   uint16_t height );
+        void fragment( std::vector< uint8_t > &out, const std::vector< Sample > &samples );
+
+        // frames that were not written: the next fragment starts after them on the timeline
+        void skip( uint32_t duration )
+        {
+            m_decode_time += duration;
+        }
+
+        uint64_t decode_time() const
+        {
+            return m_decode_time;
+        }
+
+    private:
+        uint32_t m_sequence {0};
+        uint64_t m_decode_time {0};
+    };
+
+}  // namespace mp4
+
+#endif //VIDEODEFECTS_MP4_H
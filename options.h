@@ -0,0 +1,53 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#ifndef VIDEODEFECTS_OPTIONS_H
+#define VIDEODEFECTS_OPTIONS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+enum class Codec { H264, JPEG };
+
+struct Options {
+    uint16_t port {5555};
+    int loops {1};                  // event loops, each on its own core
+    uint16_t rtp_port {6970};       // RTP/UDP server port (RTCP - the next one), 0 - TCP only
+    bool io_uring {false};          // io_uring event loops instead of epoll (if built WITH_IO_URING)
+    size_t zerocopy {0};            // MSG_ZEROCOPY for tcp writes of at least that many bytes, 0 - off
+    std::string impairment;         // network impairment profile of RTP over UDP sessions, empty - none
+    std::string tls_cert;           // RTSPS certificate chain (PEM), empty - plain RTSP (if built WITH_TLS)
+    std::string tls_key;            // its private key, empty - in the certificate file
+    bool keyframe_on_join {false};
+    uint16_t http_port {0};         // HTTP port of fMP4 and LL-HLS, 0 - none
+    std::string multicast;          // multicast group, empty - no multicast sessions
+    uint16_t multicast_port {5004}; // multicast RTP port (RTCP - the next one)
+    int multicast_ttl {1};
+    std::string multicast_if;       // outgoing interface address, empty - by the routing table
+
+    Codec codec {Codec::H264};
+    int bitrate {0};                // CBR bitrate (kbit/s), 0 - CRF
+    int vbv_maxrate {0};            // VBV max rate (kbit/s), 0 - equal to bitrate
+    int vbv_bufsize {0};            // VBV buffer (kbit), 0 - two frames at max rate
+    bool intra_refresh {false};     // periodic intra refresh instead of IDR frames
+    int jpeg_quality {80};
+    int jpeg_strips {0};            // parallel JPEG strips, 0 - one per OpenCV thread
+    bool jpeg_restart {false};      // restart marker after every MCU row
+
+    std::string record;             // recording file prefix, empty - no recording
+    uint32_t record_formats {0x01}; // Recorder::Format flags
+    size_t record_size {0};         // rotate after that many bytes, 0 - never
+    int record_duration {0};        // rotate after that many seconds, 0 - never
+
+    bool governor {false};          // adapt the pipeline to the frame budget
+    uint32_t frame_pool {0x01};     // FramePool flags, 0 - the standard cv::Mat allocator
+    int preview_width {1280};       // wider frames are previewed scaled down, 0 - at the source size
+    double preview_fps {0};         // preview frame rate, 0 - every frame
+    bool headless {false};          // no preview window, paced by the monotonic clock
+    std::string control;            // [address:]port of the udp control channel, empty - none
+};
+
+
+#endif //VIDEODEFECTS_OPTIONS_H
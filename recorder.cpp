@@ -0,0 +1,375 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#include "recorder.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+    const uint8_t start_code[] = { 0, 0, 0, 1 };
+    const uint32_t FRAGMENT_DURATION = mp4::Muxer::TIMESCALE;  // one second
+
+    void put_length( std::vector< uint8_t > &out, uint32_t size )
+    {
+        uint32_t be = htobe32( size );
+        const uint8_t *p = (const uint8_t *)&be;
+        out.insert( out.end(), p, p + sizeof(be) );
+    }
+
+}  // namespace
+
+
+Recorder::Recorder( const std::string &prefix, Codec codec, uint32_t formats, size_t max_size, int max_duration )
+: m_prefix( prefix )
+, m_codec( codec )
+, m_max_size( max_size )
+, m_max_duration( max_duration )
+, m_blocks( BLOCKS )
+{
+    if( formats & Format::AnnexB )
+    {
+        m_tracks.emplace_back();
+        m_tracks.back().format = Format::AnnexB;
+    }
+    if( m_codec == Codec::JPEG && (formats & Format::MP4) )
+    {
+        // MJPEG пишется только как последовательность JPEG-кадров
+        std::cerr << "[recorder] mp4 recording is available for h264 only\n";
+        if( m_tracks.empty() )
+        {
+            m_tracks.emplace_back();
+            m_tracks.back().format = Format::AnnexB;
+        }
+    }
+    else if( formats & Format::MP4 )
+    {
+        m_tracks.emplace_back();
+        m_tracks.back().format = Format::MP4;
+    }
+
+    for( auto &b : m_blocks )
+    {
+        void *ptr = nullptr;
+        if( posix_memalign( &ptr, 4096, BLOCK_SIZE ) )
+        {
+            for( auto p : m_free )
+            {
+                free( p->data );
+            }
+            throw std::runtime_error( "[recorder] failed to allocate write buffers" );
+        }
+        b.data = (uint8_t *)ptr;
+        b.size = 0;
+        m_free.push_back( &b );
+    }
+    m_flushed = std::chrono::steady_clock::now();
+    m_thread = std::thread( [this](){ f_run(); } );
+}
+
+Recorder::~Recorder()
+{
+    for( auto &t : m_tracks )
+    {
+        if( t.format == Format::MP4 && t.synced )
+        {
+            f_fragment( t );
+        }
+        f_submit( t );
+    }
+    {
+        std::lock_guard< std::mutex > lk( m_mutex );
+        m_running = false;
+    }
+    m_cond.notify_one();
+    m_thread.join();
+
+    for( auto &b : m_blocks )
+    {
+        free( b.data );
+    }
+    if( m_dropped.load() )
+    {
+        std::cerr << "[recorder] " << m_dropped.load() << " access units dropped\n";
+    }
+}
+
+void Recorder::store( const Encoder::PS &sps,
+                      const Encoder::PS &pps,
+                      const uint8_t *data,
+                      size_t size,
+                      bool keyframe,
+                      int delay,
+                      int width,
+                      int height )
+{
+    auto now = std::chrono::steady_clock::now();
+    bool new_sps = !sps.empty() && sps != m_sps;
+
+    uint32_t duration = uint32_t(delay) * (mp4::Muxer::TIMESCALE / 1000);
+    for( auto &t : m_tracks )
+    {
+        if( keyframe && (m_codec == Codec::JPEG || (!sps.empty() && !pps.empty())) )
+        {
+            bool rotate = !t.open || new_sps ||
+                          (m_max_size && t.file_size >= m_max_size) ||
+                          (m_max_duration.count() && now - t.opened >= m_max_duration);
+            if( rotate )
+            {
+                f_open( t, sps, pps, width, height );
+            }
+            // the init segment may not have been queued: nothing is written up to the next keyframe
+            t.synced = t.open;
+        }
+        if( !t.synced )
+        {
+            if( t.open && t.format == Format::MP4 )
+            {
+                t.muxer.skip( duration );
+            }
+            continue;
+        }
+
+        bool written = true;
+        if( t.format == Format::AnnexB )
+        {
+            t.scratch.clear();
+            if( m_codec == Codec::JPEG )
+            {
+                t.scratch.insert( t.scratch.end(), data, data + size );
+            }
+            else
+            {
+                if( keyframe && !sps.empty() && !pps.empty() )
+                {
+                    t.scratch.insert( t.scratch.end(), start_code, start_code + sizeof(start_code) );
+                    t.scratch.insert( t.scratch.end(), sps.begin(), sps.end() );
+                    t.scratch.insert( t.scratch.end(), start_code, start_code + sizeof(start_code) );
+                    t.scratch.insert( t.scratch.end(), pps.begin(), pps.end() );
+                }
+                t.scratch.insert( t.scratch.end(), start_code, start_code + sizeof(start_code) );
+                t.scratch.insert( t.scratch.end(), data, data + size );
+            }
+            written = f_write( t, t.scratch.data(), t.scratch.size() );
+        }
+        else
+        {
+            if( !t.samples.empty() && (keyframe || t.fragment_duration >= FRAGMENT_DURATION) )
+            {
+                f_fragment( t );
+                if( !t.synced )
+                {
+                    // the fragment is lost: nothing is appended up to the next keyframe
+                    t.muxer.skip( duration );
+                    continue;
+                }
+            }
+            put_length( t.sample_data, size );
+            t.sample_data.insert( t.sample_data.end(), data, data + size );
+            t.samples.push_back( mp4::Sample{ nullptr, uint32_t(size + sizeof(uint32_t)), duration, keyframe } );
+            t.fragment_duration += duration;
+        }
+
+        if( !written )
+        {
+            // no free block: skip up to the next keyframe to keep the file decodable
+            ++m_dropped;
+            t.synced = false;
+            t.samples.clear();
+            t.sample_data.clear();
+            t.fragment_duration = 0;
+        }
+    }
+    if( !sps.empty() )
+    {
+        m_sps = sps;
+    }
+
+    if( now - m_flushed >= std::chrono::seconds( 1 ) )
+    {
+        for( auto &t : m_tracks )
+        {
+            f_submit( t );
+        }
+        m_flushed = now;
+    }
+}
+
+void Recorder::f_run()
+{
+    std::vector< int > fds( m_tracks.size(), -1 );
+    while( true )
+    {
+        Block *b;
+        {
+            std::unique_lock< std::mutex > lk( m_mutex );
+            m_cond.wait( lk, [this](){ return !m_queue.empty() || !m_running; } );
+            if( m_queue.empty() )
+            {
+                break;
+            }
+            b = m_queue.front();
+            m_queue.pop_front();
+        }
+
+        int &fd = fds[b->track];
+        if( !b->path.empty() )
+        {
+            if( fd != -1 )
+            {
+                close( fd );
+            }
+            fd = open( b->path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 );
+            if( fd == -1 )
+            {
+                std::cerr << "[recorder] open " << b->path << " failed: " << strerror( errno ) << std::endl;
+            }
+            else
+            {
+                std::cerr << "[recorder] writing " << b->path << "\n";
+            }
+        }
+
+        size_t off = 0;
+        while( fd != -1 && off < b->size )
+        {
+            ssize_t rc = ::write( fd, b->data + off, b->size - off );
+            if( rc < 0 )
+            {
+                if( errno == EINTR )
+                {
+                    continue;
+                }
+                std::cerr << "[recorder] write failed: " << strerror( errno ) << std::endl;
+                break;
+            }
+            off += rc;
+        }
+
+        b->size = 0;
+        b->path.clear();
+        std::lock_guard< std::mutex > lk( m_mutex );
+        m_free.push_back( b );
+    }
+
+    for( int fd : fds )
+    {
+        if( fd != -1 )
+        {
+            close( fd );
+        }
+    }
+}
+
+void Recorder::f_open( Track &track, const Encoder::PS &sps, const Encoder::PS &pps, int width, int height )
+{
+    if( track.format == Format::MP4 && track.synced )
+    {
+        f_fragment( track );
+    }
+    f_submit( track );
+
+    track.path = f_filename( track );
+    track.open = true;
+    track.file_size = 0;
+    track.opened = std::chrono::steady_clock::now();
+    track.samples.clear();
+    track.sample_data.clear();
+    track.fragment_duration = 0;
+
+    if( track.format == Format::MP4 )
+    {
+        track.scratch.clear();
+        track.muxer.init( track.scratch, sps, pps, width, height );
+        if( !f_write( track, track.scratch.data(), track.scratch.size() ) )
+        {
+            // the file is reopened on the next keyframe
+            ++m_dropped;
+            track.open = false;
+        }
+    }
+}
+
+void Recorder::f_fragment( Track &track )
+{
+    const uint8_t *ptr = track.sample_data.data();
+    for( auto &s : track.samples )
+    {
+        s.data = ptr;
+        ptr += s.size;
+    }
+    track.scratch.clear();
+    track.muxer.fragment( track.scratch, track.samples );
+    if( !f_write( track, track.scratch.data(), track.scratch.size() ) )
+    {
+        ++m_dropped;
+        track.synced = false;
+    }
+    track.samples.clear();
+    track.sample_data.clear();
+    track.fragment_duration = 0;
+}
+
+bool Recorder::f_write( Track &track, const uint8_t *data, size_t size )
+{
+    size_t available = track.block ? BLOCK_SIZE - track.block->size : 0;
+    if( available < size )
+    {
+        std::lock_guard< std::mutex > lk( m_mutex );
+        if( available + m_free.size() * BLOCK_SIZE < size )
+        {
+            return false;
+        }
+    }
+
+    while( size )
+    {
+        if( !track.block || track.block->size == BLOCK_SIZE )
+        {
+            f_submit( track );
+            std::lock_guard< std::mutex > lk( m_mutex );
+            track.block = m_free.back();
+            m_free.pop_back();
+            track.block->track = &track - m_tracks.data();
+            track.block->path.swap( track.path );
+        }
+        size_t sz = std::min( size, BLOCK_SIZE - track.block->size );
+        memcpy( track.block->data + track.block->size, data, sz );
+        track.block->size += sz;
+        track.file_size += sz;
+        data += sz;
+        size -= sz;
+    }
+    return true;
+}
+
+void Recorder::f_submit( Track &track )
+{
+    if( track.block )
+    {
+        {
+            std::lock_guard< std::mutex > lk( m_mutex );
+            m_queue.push_back( track.block );
+        }
+        m_cond.notify_one();
+        track.block = nullptr;
+    }
+}
+
+std::string Recorder::f_filename( const Track &track )
+{
+    char buf[32];
+    time_t t = time( nullptr );
+    strftime( buf, sizeof(buf), "%Y%m%d_%H%M%S", localtime( &t ) );
+
+    return m_prefix + "_" + buf + "_" + std::to_string( m_file_count++ ) +
+           (track.format == Format::MP4 ? ".mp4" : (m_codec == Codec::JPEG ? ".mjpeg" : ".h264"));
+}
@@ -0,0 +1,107 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#ifndef VIDEODEFECTS_RECORDER_H
+#define VIDEODEFECTS_RECORDER_H
+
+#include "encoder.h"
+#include "mp4.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Writes the encoded access units to disk on a dedicated I/O thread.
+// The producer only copies data into preallocated page-aligned blocks; when the
+// disk stalls and no free block is left, access units are dropped up to the next
+// keyframe instead of blocking the caller.
+class Recorder {
+public:
+    enum Format { AnnexB = 0x01, MP4 = 0x02 };
+
+    static const size_t BLOCK_SIZE = 4 * 1024 * 1024;
+    static const size_t BLOCKS = 8;
+
+    Recorder( const std::string &prefix, Codec codec, uint32_t formats, size_t max_size, int max_duration );
+    Recorder( const Recorder& orig ) = delete;
+    Recorder &operator =( const Recorder& orig ) = delete;
+    ~Recorder();
+
+    void store( const Encoder::PS &sps,
+                const Encoder::PS &pps,
+                const uint8_t *data,
+                size_t size,
+                bool keyframe,
+                int delay,
+                int width,
+                int height );
+
+    size_t dropped() const
+    {
+        return m_dropped.load();
+    }
+
+private:
+    struct Block
+    {
+        uint8_t *data;
+        size_t size;
+        size_t track;
+        std::string path;   // not empty - the block starts a new file
+    };
+
+    struct Track
+    {
+        Format format;
+        Block *block {nullptr};
+        std::string path;   // file to be opened with the next block
+        bool open {false};
+        size_t file_size {0};
+        std::chrono::steady_clock::time_point opened;
+        bool synced {false};
+
+        mp4::Muxer muxer;
+        std::vector< uint8_t > sample_data;
+        std::vector< mp4::Sample > samples;
+        uint32_t fragment_duration {0};
+
+        std::vector< uint8_t > scratch;
+    };
+
+    std::string m_prefix;
+    Codec m_codec;
+    size_t m_max_size;
+    std::chrono::seconds m_max_duration;
+
+    std::vector< Track > m_tracks;
+    Encoder::PS m_sps;
+    size_t m_file_count {0};
+    std::chrono::steady_clock::time_point m_flushed;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque< Block* > m_queue;
+    std::vector< Block* > m_free;
+    std::vector< Block > m_blocks;
+    bool m_running {true};
+    std::atomic< size_t > m_dropped {0};
+
+    std::thread m_thread;
+
+private:
+    void f_run();
+    void f_open( Track &track, const Encoder::PS &sps, const Encoder::PS &pps, int width, int height );
+    void f_fragment( Track &track );
+    bool f_write( Track &track, const uint8_t *data, size_t size );
+    void f_submit( Track &track );
+    std::string f_filename( const Track &track );
+};
+
+
+#endif //VIDEODEFECTS_RECORDER_H
@@ -6,8 +6,15 @@
  */
 
 #include "connection.h"
+#ifdef WITH_TLS
+#include "tls.h"
+#endif
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <algorithm>
+#include <cerrno>
 #include <unistd.h>
-#include <fcntl.h>
+#include <sys/uio.h>
 #include <uuid/uuid.h>
 #include <cstring>
 #include <iostream>
@@ -32,186 +39,859 @@ namespace
         return rc;
     }
 
-    const char *ok = "RTSP/1.0 200 OK\r\n";
-    const char *options = "Public: OPTIONS, DESCRIBE, SETUP, TEARDOWN, PLAY, PAUSE\r\n\r\n";
+    const char *methods = "Public: OPTIONS, DESCRIBE, SETUP, TEARDOWN, PLAY, PAUSE, GET_PARAMETER, SET_PARAMETER\r\n";
+
+    const size_t REPLY_RESERVE = 4096;
+
+    const char *CNAME = "videodefects";
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
 
 }  // namespace
 
-rtsp::Connection::Connection( int b_sock, const std::string &sdp )
-: m_fd( accept( b_sock, (struct sockaddr *)&m_address, &m_socklen ) )
+rtsp::Connection::Connection( int fd,
+                              const sockaddr_in &address,
+                              const std::string &sdp,
+                              Codec codec,
+                              UdpSocket *udp,
+                              UdpSocket *rtcp,
+                              const Multicast *multicast,
+                              AsyncWriter *writer,
+                              size_t zerocopy,
+                              TimerWheel *timers,
+                              const Impairment::Profile *impairment,
+                              const TlsContext *tls )
+: m_fd( fd )
+, m_address( address )
+, m_active( std::chrono::steady_clock::now() )
+, m_progress( m_active )
+, m_writer( writer )
 , m_sdp( sdp )
 , m_session( uuid() )
+, m_codec( codec )
+, m_udp( udp )
+, m_multicast( multicast )
+, m_rtcp( rtcp )
+, m_zerocopy( writer || tls ? 0 : zerocopy )
+, m_timers( timers )
 {
-    fcntl( m_fd, F_SETFD, fcntl( m_fd, F_GETFD, 0) | O_NONBLOCK );
+    if( impairment )
+    {
+        m_impairment_profile = *impairment;
+    }
+    m_reply.reserve( REPLY_RESERVE );
+    if( m_writer )
+    {
+        m_reply_out.reserve( REPLY_RESERVE );
+    }
+#ifdef WITH_TLS
+    if( tls )
+    {
+        // the first bytes from the client are its ClientHello
+        try
+        {
+            m_tls.reset( new TlsSession( *tls, m_fd ) );
+        }
+        catch( const TlsError &err )
+        {
+            // never plaintext: the loop closes the connection
+            std::cerr << err.what() << "\n";
+            m_closing = true;
+        }
+    }
+#else
+    (void)tls;
+#endif
+    int one = 1;
+    if( m_zerocopy && setsockopt( m_fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one) ) == -1 )
+    {
+        std::cerr << "[*] zerocopy is not available: " << strerror( errno ) << "\n";
+        m_zerocopy = 0;
+    }
     std::cerr << "[+] connected with " << saddr2str(m_address) << ":" << ntohs(m_address.sin_port) << "\n";
 }
 
 rtsp::Connection::~Connection()
 {
     close( m_fd );
-    std::cerr << "[-] connection " << saddr2str(m_address) << ":" << ntohs(m_address.sin_port) << " closed\n";
+    std::cerr << "[-] connection " << saddr2str(m_address) << ":" << ntohs(m_address.sin_port) << " closed";
+    if( m_dropped )
+    {
+        std::cerr << ", " << m_dropped << " frames dropped";
+    }
+    if( m_lost || m_jitter || m_rtt >= 0. )
+    {
+        std::cerr << ", lost " << m_lost << " packets, jitter " << m_jitter / (rtp::Header::CLOCK_RATE / 1000) << " ms";
+        if( m_rtt >= 0. )
+        {
+            std::cerr << ", rtt " << m_rtt << " ms";
+        }
+    }
+    std::cerr << "\n";
 }
 
 void rtsp::Connection::on_data( const uint8_t * data, int size )
 {
-    m_rtsp_sent = 0;
-    m_request += std::string((const char*)data, size);
+    m_active = std::chrono::steady_clock::now();
+#ifdef WITH_TLS
+    if( m_tls )
+    {
+        if( m_closing )
+        {
+            return;
+        }
+        bool established = m_tls->established();
+        m_tls_plain.clear();
+        if( !m_tls->receive( data, size, m_tls_plain ) )
+        {
+            std::cerr << "[-] " << saddr2str(m_address) << ":" << ntohs(m_address.sin_port) << " tls: " << m_tls->error() << "\n";
+            m_closing = true;
+            return;
+        }
+        if( !established && m_tls->established() )
+        {
+            std::cerr << "[+] " << saddr2str(m_address) << ":" << ntohs(m_address.sin_port) << " tls: "
+                      << m_tls->description() << ", encrypted by the kernel\n";
+        }
+        if( m_tls_plain.empty() )
+        {
+            return;
+        }
+        data = m_tls_plain.data();
+        size = m_tls_plain.size();
+    }
+#endif
+    // a read may be larger than the free space of the buffer: it is fed in parts, each after
+    // the messages of the previous one are handled
+    for( size_t done = 0; done < size_t(size) && !m_closing; )
+    {
+        size_t fed = m_parser.feed( data + done, size - done );
+        if( !fed )
+        {
+            std::cerr << "[-] " << saddr2str(m_address) << ":" << ntohs(m_address.sin_port) << " bad request\n";
+            m_closing = true;
+            return;
+        }
+        done += fed;
+
+        Parser::Message msg;
+        while( !m_closing && m_parser.next( msg ) )
+        {
+            f_message( msg );
+        }
+        if( m_parser.failed() )
+        {
+            std::cerr << "[-] " << saddr2str(m_address) << ":" << ntohs(m_address.sin_port) << " bad request\n";
+            m_closing = true;
+        }
+    }
+}
 
-    if( m_request.find( "\r\n\r\n" ) != std::string::npos )
+void rtsp::Connection::f_message( const Parser::Message &msg )
+{
+    if( msg.interleaved )
     {
-        std::cerr << m_request << std::endl;
+        // RTCP from the client goes over the odd channel
+        if( msg.channel == 1 )
+        {
+            on_rtcp( msg.data, msg.size );
+        }
+        return;
+    }
+    std::cerr << "[*] " << msg.method_name << " " << msg.uri << "\n";
+    f_impairment_profile( msg.uri );
+
+    switch( msg.method )
+    {
+    case Parser::Method::OPTIONS:
+        f_begin_reply( msg );
+        m_reply.append( methods );
+        f_end_reply();
+        break;
+    case Parser::Method::DESCRIBE:
+        f_reply_describe( msg );
+        break;
+    case Parser::Method::SETUP:
+        f_reply_setup( msg );
+        break;
+    case Parser::Method::PLAY:
+        f_reply_play( msg );
+        break;
+    case Parser::Method::PAUSE:
+        f_reply_pause( msg );
+        break;
+    case Parser::Method::TEARDOWN:
+        f_begin_reply( msg );
+        f_end_reply();
+        m_playing = false;
+        m_closing = true;
+        break;
+    case Parser::Method::GET_PARAMETER:
+        // keepalive
+        f_begin_reply( msg );
+        f_end_reply();
+        break;
+    case Parser::Method::SET_PARAMETER:
+        // there are no parameters to set, an empty request is a keepalive
+        f_begin_reply( msg, msg.body.empty() ? "200 OK" : "451 Parameter Not Understood" );
+        f_end_reply();
+        break;
+    default:
+        f_begin_reply( msg, "501 Not Implemented" );
+        m_reply.append( methods );
+        f_end_reply();
+    }
+}
 
-        if( m_request.find( "OPTIONS " ) != std::string::npos )
+void rtsp::Connection::on_ready_to_write()
+{
+#ifdef WITH_TLS
+    if( m_tls && !m_tls->established() )
+    {
+        // a handshake message that did not fit into the socket buffer
+        std::vector< uint8_t > none;
+        if( !m_tls->receive( nullptr, 0, none ) )
         {
-            f_reply( options );
+            m_closing = true;
         }
-        if( m_request.find( "DESCRIBE " ) != std::string::npos )
+        return;
+    }
+#endif
+    f_flush();
+}
+
+void rtsp::Connection::send_frame( const rtp::Packetized &unit )
+{
+    const rtp::SharedFrame &frame = unit.get( m_udp_address.sin_port );
+    if( m_playing && !m_multicast_session && !frame->packets.empty() )
+    {
+        if( m_queue.size() >= MAX_QUEUED_FRAMES || m_queued + frame->data.size() > MAX_QUEUED_BYTES )
         {
-            f_reply_describe();
+            f_drop( frame->data.size() );
         }
-        if( m_request.find( "SETUP " ) != std::string::npos )
+        if( m_codec == Codec::H264 && !f_can_be_sent( *frame ) )
         {
-            f_reply_setup();
+            if( m_skipping )
+            {
+                ++m_dropped;
+            }
+            return;
         }
-        if( m_request.find( "PLAY " ) != std::string::npos )
+        m_skipping = false;
+
+        if( m_udp_address.sin_port )
         {
-            f_reply_play();
+            f_send_udp( frame );
+            return;
         }
 
-        m_request.clear();
+        Pending p;
+        p.frame = frame;
+        m_queued += frame->data.size();
+        m_queue.push_back( std::move( p ) );
+
+        f_flush();
     }
 }
 
-void rtsp::Connection::on_ready_to_write()
+void rtsp::Connection::on_rtcp( const uint8_t *data, size_t size )
+{
+    m_active = std::chrono::steady_clock::now();
+    rtcp::Feedback fb;
+    if( rtcp::parse( data, size, m_rtp.ssrc(), fb ) )
+    {
+        f_feedback( fb );
+    }
+}
+
+void rtsp::Connection::report( std::chrono::steady_clock::time_point now )
 {
-    if( m_rtsp_sent < m_reply.size() )
+    if( !m_playing || m_multicast_session || !m_rtp.packets() || now - m_reported < REPORT_INTERVAL )
+    {
+        return;
+    }
+    m_reported = now;
+
+    uint8_t sr[rtp::Interleaved::SIZE + rtcp::MAX_SIZE];
+    size_t size = rtcp::sender_report( sr + rtp::Interleaved::SIZE,
+                                       m_rtp.ssrc(),
+                                       rtcp::ntp_now(),
+                                       m_rtp.timestamp( now ),
+                                       m_rtp.packets(),
+                                       m_rtp.octets(),
+                                       CNAME );
+    if( m_udp_address.sin_port )
     {
-        int rc = ::write( m_fd, m_reply.data() + m_rtsp_sent, m_reply.size() - m_rtsp_sent );
-        if( rc > 0 )
+        if( m_rtcp )
         {
-            m_rtsp_sent += rc;
+            m_rtcp->send( m_rtcp_address, sr + rtp::Interleaved::SIZE, size );
         }
+        return;
     }
+    // goes out with the replies between the interleaved RTP packets
+    rtp::Interleaved( 1 ).serialize( sr, size );
+    m_reply.append( (const char *)sr, rtp::Interleaved::SIZE + size );
+    f_flush();
+}
 
-    if( m_rtp_sent < m_frame.size() )
+void rtsp::Connection::f_feedback( const rtcp::Feedback &fb )
+{
+    if( fb.keyframe )
     {
-        int rc = ::write( m_fd, m_frame.data() + m_rtp_sent, m_frame.size() - m_rtp_sent );
-        if( rc > 0 )
+        m_keyframe_requested = true;
+    }
+    m_nacks += fb.nacks;
+    if( !fb.report )
+    {
+        return;
+    }
+
+    bool lost = fb.cumulative_lost > m_lost;
+    m_jitter = fb.jitter;
+    double rtt = rtcp::rtt_ms( fb, rtcp::ntp_now() );
+    if( rtt >= 0. )
+    {
+        m_rtt = rtt;
+    }
+
+    bool lossy = m_lossy ? fb.fraction_lost > LOSSY_OFF : fb.fraction_lost >= LOSSY_ON;
+    if( lossy != m_lossy )
+    {
+        m_lossy = lossy;
+        std::cerr << "[*] " << saddr2str(m_address) << ":" << ntohs(m_address.sin_port)
+                  << (m_lossy ? " loses " : " recovered, loss ") << fb.fraction_lost * 100 / 256 << "%, jitter "
+                  << m_jitter / (rtp::Header::CLOCK_RATE / 1000) << " ms, rtt " << m_rtt << " ms"
+                  << (m_lossy ? ", skipping to the next keyframe on a loss\n" : "\n");
+    }
+
+    if( lost && m_codec == Codec::H264 )
+    {
+        // without retransmissions the picture is broken up to the next keyframe
+        m_keyframe_requested = true;
+        if( m_lossy )
         {
-            m_rtp_sent += rc;
+            // the frames up to it are of no use and only load the lossy path
+            f_skip();
         }
     }
+    m_lost = fb.cumulative_lost;
 }
 
-void rtsp::Connection::send_frame( const uint8_t *data, size_t size, size_t full_size, int delay )
+void rtsp::Connection::f_flush()
 {
-    if( m_playing )
+    while( !m_writing && (m_rtsp_sent < m_reply.size() || !m_queue.empty()) )
     {
-        if( !f_can_be_sent( ((*data) & 0x1f) ) )
+        size_t total = f_gather();
+        if( m_writer )
+        {
+            // the rest goes out from on_written()
+            m_writing = true;
+            m_writer->write( *this, m_msg );
+            return;
+        }
+
+        ssize_t rc = m_zerocopy && !m_writing_reply && total >= m_zerocopy ? f_send_zerocopy()
+                                                                           : ::sendmsg( m_fd, &m_msg, MSG_NOSIGNAL );
+        if( rc <= 0 )
         {
             return;
         }
+        f_written( rc );
+        if( size_t(rc) < total )
+        {
+            // the socket buffer is full, the rest goes out on EPOLLOUT
+            return;
+        }
+    }
+}
+
+void rtsp::Connection::on_written( ssize_t rc )
+{
+    m_writing = false;
+    if( rc < 0 && rc != -EAGAIN && rc != -EINTR )
+    {
+        m_write_failed = true;
+        return;
+    }
+    if( rc > 0 )
+    {
+        f_written( rc );
+    }
+    f_flush();
+}
+
+size_t rtsp::Connection::f_gather()
+{
+    const size_t hs = rtp::Session::HEADER_SIZE;
+    int count = 0;
+    size_t total = 0;
+    m_gathered = 0;
+
+    // replies go between the interleaved packets, never inside one
+    bool boundary = m_queue.empty() || m_queue.front().offset == 0;
+    m_writing_reply = m_rtsp_sent < m_reply.size() && boundary;
+    if( m_writing_reply && m_writer )
+    {
+        // replies appended while the write is in flight must not move the bytes being sent
+        m_reply_out.assign( m_reply, m_rtsp_sent, std::string::npos );
+        m_iov[0].iov_base = m_reply_out.data();
+        m_iov[0].iov_len = m_reply_out.size();
+        total = m_iov[0].iov_len;
+        count = 1;
+    }
+    else if( m_writing_reply )
+    {
+        m_iov[0].iov_base = m_reply.data() + m_rtsp_sent;
+        m_iov[0].iov_len = m_reply.size() - m_rtsp_sent;
+        total = m_iov[0].iov_len;
+        count = 1;
+    }
+    else
+    {
+        // the session's headers and the shared payloads go out in one gather write
+        for( auto q = m_queue.begin(); q != m_queue.end() && count + 2 <= MAX_IOV && !(count && m_rtsp_sent < m_reply.size()); ++q )
+        {
+            if( q->headers.empty() )
+            {
+                const rtp::Frame &fr = *q->frame;
+                q->headers.resize( fr.packets.size() * hs );
+                for( size_t i = 0; i < fr.packets.size(); ++i )
+                {
+                    m_rtp.patch( q->headers.data() + i * hs, fr.data.data() + fr.packets[i] );
+                }
+            }
+            ++m_gathered;
+            for( size_t i = q->packet; i < q->frame->packets.size() && count + 2 <= MAX_IOV; ++i )
+            {
+                if( count && m_rtsp_sent < m_reply.size() )
+                {
+                    // only the rest of the current packet before a pending reply
+                    break;
+                }
+                size_t off = i == q->packet ? q->offset : 0;
+                if( off < hs )
+                {
+                    m_iov[count].iov_base = q->headers.data() + i * hs + off;
+                    m_iov[count].iov_len = hs - off;
+                    total += m_iov[count].iov_len;
+                    ++count;
+                    off = hs;
+                }
+                m_iov[count].iov_base = (void *)(q->frame->data.data() + q->frame->packets[i] + off);
+                m_iov[count].iov_len = q->frame->packet_size( i ) - off;
+                total += m_iov[count].iov_len;
+                ++count;
+            }
+        }
+    }
+
+    m_msg.msg_iov = m_iov;
+    m_msg.msg_iovlen = count;
+    return total;
+}
+
+void rtsp::Connection::f_written( size_t size )
+{
+    if( size )
+    {
+        m_progress = std::chrono::steady_clock::now();
+    }
+    if( m_writing_reply )
+    {
+        m_rtsp_sent += size;
+        if( m_rtsp_sent >= m_reply.size() )
+        {
+            m_reply.clear();
+            m_rtsp_sent = 0;
+        }
+        return;
+    }
 
-        size_t left = m_frame.size() - m_rtp_sent;
-        std::vector< uint8_t > fr( left + full_size );
-        if( left )
+    while( size && !m_queue.empty() )
+    {
+        Pending &q = m_queue.front();
+        size_t left = q.frame->packet_size( q.packet ) - q.offset;
+        if( size < left )
+        {
+            q.offset += size;
+            break;
+        }
+        size -= left;
+        q.offset = 0;
+        if( ++q.packet == q.frame->packets.size() )
         {
-            memcpy( fr.data(), m_frame.data() + m_rtp_sent, left );
+            m_queued -= q.frame->data.size();
+            if( q.zerocopy && !m_pinned.empty() )
+            {
+                // the headers and the payload stay until the kernel is done with them
+                m_pinned.back().frames.push_back( std::move( q ) );
+            }
+            m_queue.pop_front();
         }
-        m_rtp.serialize( data, size, fr.data() + left, delay );
+    }
+}
 
-        std::swap( m_frame, fr );
+ssize_t rtsp::Connection::f_send_zerocopy()
+{
+    ssize_t rc = ::sendmsg( m_fd, &m_msg, MSG_ZEROCOPY | MSG_NOSIGNAL );
+    if( rc < 0 && errno == ENOBUFS )
+    {
+        // too many sends waiting for completion (optmem_max): this one is copied
+        return ::sendmsg( m_fd, &m_msg, MSG_NOSIGNAL );
+    }
+    if( rc > 0 )
+    {
+        for( size_t i = 0; i < m_gathered && i < m_queue.size(); ++i )
+        {
+            m_queue[i].zerocopy = true;
+        }
+        m_pinned.push_back( Pinned{ m_zerocopy_id++, {} } );
+    }
+    return rc;
+}
 
-        m_rtp_sent = 0;
-        int rc = ::write( m_fd, m_frame.data(), m_frame.size() );
-        if( rc > 0 )
+bool rtsp::Connection::on_error()
+{
+    while( true )
+    {
+        char control[128];
+        msghdr msg;
+        memset( &msg, 0, sizeof(msg) );
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if( ::recvmsg( m_fd, &msg, MSG_ERRQUEUE ) < 0 )
         {
-            m_rtp_sent = rc;
+            break;
+        }
+        for( cmsghdr *cm = CMSG_FIRSTHDR( &msg ); cm; cm = CMSG_NXTHDR( &msg, cm ) )
+        {
+            if( cm->cmsg_level != SOL_IP || cm->cmsg_type != IP_RECVERR )
+            {
+                continue;
+            }
+            sock_extended_err ee;
+            memcpy( &ee, CMSG_DATA( cm ), sizeof(ee) );
+            if( ee.ee_errno || ee.ee_origin != SO_EE_ORIGIN_ZEROCOPY )
+            {
+                continue;
+            }
+            if( (ee.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) && !m_zerocopy_copied )
+            {
+                m_zerocopy_copied = true;
+                std::cerr << "[*] " << saddr2str(m_address) << ":" << ntohs(m_address.sin_port) << " zerocopy sends are copied by the kernel\n";
+            }
+            // sends ee_info..ee_data are complete, tcp completes them in order
+            while( !m_pinned.empty() && int32_t(ee.ee_data - m_pinned.front().id) >= 0 )
+            {
+                m_pinned.pop_front();
+            }
         }
     }
+    int error = 0;
+    socklen_t len = sizeof(error);
+    return getsockopt( m_fd, SOL_SOCKET, SO_ERROR, &error, &len ) == 0 && !error;
 }
 
-void rtsp::Connection::f_reply(const char *reply_line)
+void rtsp::Connection::f_send_udp( const rtp::SharedFrame &frame )
 {
-    size_t p1 = m_request.find( "CSeq:" );
-    if( p1 != std::string::npos )
+    const size_t hs = rtp::Session::HEADER_SIZE;
+    m_udp_headers.resize( frame->packets.size() * hs );
+    for( size_t i = 0; i < frame->packets.size(); ++i )
+    {
+        m_rtp.patch( m_udp_headers.data() + i * hs, frame->data.data() + frame->packets[i] );
+    }
+    if( m_impairment )
     {
-        size_t p2 = m_request.find( "\r\n", p1 );
-        if( p2 != std::string::npos )
+        // the sequence numbers are assigned already: a lost packet leaves a gap
+        auto now = std::chrono::steady_clock::now();
+        for( size_t i = 0; i < frame->packets.size(); ++i )
         {
-            m_reply = ok + m_request.substr( p1, p2 - p1 + 2 ) + reply_line;
+            m_impairment->send( m_udp_headers.data() + i * hs, frame, i, now );
+        }
+        return;
+    }
+    // a datagram that does not fit into the socket buffer is lost like any other udp loss
+    if( m_udp->send( m_udp_address, *frame, m_udp_headers.data() ) < frame->packets.size() )
+    {
+        ++m_dropped;
+    }
+}
 
-            std::cerr << m_reply << std::endl;
+void rtsp::Connection::f_impairment_profile( std::string_view uri )
+{
+    // clients resolve the control url against the DESCRIBE one and may lose the query,
+    // so the profile from any request of the connection is kept
+    size_t p = uri.find( "impairment=" );
+    if( p == std::string_view::npos )
+    {
+        return;
+    }
+    std::string_view text = uri.substr( p + strlen( "impairment=" ) );
+    // a relative control url may be appended after the query
+    text = text.substr( 0, text.find_first_of( "&/" ) );
+    Impairment::Profile profile;
+    if( !profile.parse( text ) )
+    {
+        std::cerr << "[-] " << saddr2str(m_address) << ":" << ntohs(m_address.sin_port)
+                  << " bad impairment profile " << text << "\n";
+        return;
+    }
+    m_impairment_profile = profile;
+}
+
+void rtsp::Connection::f_drop( size_t incoming )
+{
+    auto fits = [this, incoming](){
+        return m_queue.size() < MAX_QUEUED_FRAMES && m_queued + incoming <= MAX_QUEUED_BYTES;
+    };
+    // frames with assigned headers are being written and stay in the queue
+    auto droppable = []( const Pending &p ){
+        return p.headers.empty();
+    };
 
-            int rc = ::write( m_fd, m_reply.data(), m_reply.size() );
-            if( rc > 0 )
+    if( m_codec == Codec::JPEG )
+    {
+        // every frame stands alone: the oldest ones go first
+        for( auto q = m_queue.begin(); q != m_queue.end() && !fits(); )
+        {
+            if( droppable( *q ) )
+            {
+                m_queued -= q->frame->data.size();
+                q = m_queue.erase( q );
+                ++m_dropped;
+            }
+            else
             {
-                m_rtsp_sent += rc;
+                ++q;
             }
         }
+        if( fits() )
+        {
+            return;
+        }
     }
+
+    // too far behind: throw away everything not started and wait for the next keyframe
+    f_skip();
+    std::cerr << "[*] " << saddr2str(m_address) << ":" << ntohs(m_address.sin_port)
+              << " is too slow, skipping to the next keyframe (" << m_dropped << " frames dropped)\n";
 }
 
-void rtsp::Connection::f_reply_describe()
+void rtsp::Connection::f_skip()
 {
-    size_t p1 = m_request.find( " RTSP/1." );
-    if( p1 != std::string::npos )
+    // frames with assigned headers are being written and stay in the queue
+    for( auto q = m_queue.begin(); q != m_queue.end(); )
     {
-        std::string reply = std::string("Date: ") + f_ctime() +
-                            std::string("Content-Base: ") + m_request.substr( 9, p1 - 9 ) + "\r\n" +
-                            std::string("Content-Type: application/sdp\r\n") +
-                            std::string("Content-Length: ") + std::to_string( m_sdp.size() ) + "\r\n\r\n" +
-                            m_sdp;
-        f_reply( reply.c_str() );
-        std::cerr << "\n";
+        if( q->headers.empty() )
+        {
+            m_queued -= q->frame->data.size();
+            q = m_queue.erase( q );
+            ++m_dropped;
+        }
+        else
+        {
+            ++q;
+        }
+    }
+    if( m_codec == Codec::H264 )
+    {
+        m_sent_flag &= ~SENT_IDR;
+        m_skipping = true;
     }
 }
 
-void rtsp::Connection::f_reply_setup()
+std::chrono::steady_clock::time_point rtsp::Connection::deadline() const
 {
-    std::string reply = std::string("Session: ") + m_session + "\r\n" +
-                        std::string( "Transport: RTP/AVP/TCP;interleaved=0-1\r\n\r\n" );
-    f_reply( reply.c_str() );
+    auto rc = m_active + SESSION_TIMEOUT;
+#ifdef WITH_TLS
+    if( m_tls && !m_tls->established() )
+    {
+        // counted from the accept (nothing is written before the handshake is over),
+        // a client trickling the handshake byte by byte does not extend it
+        return m_progress + HANDSHAKE_TIMEOUT;
+    }
+#endif
+    bool output = m_writing || m_rtsp_sent < m_reply.size() || !m_queue.empty();
+    if( output )
+    {
+        rc = std::min( rc, m_progress + SEND_TIMEOUT );
+    }
+    return rc;
+}
+
+void rtsp::Connection::on_timeout( std::chrono::steady_clock::time_point now )
+{
+    const char *what = now >= m_active + SESSION_TIMEOUT ? " session timed out\n" : " does not read, send timed out\n";
+#ifdef WITH_TLS
+    if( m_tls && !m_tls->established() )
+    {
+        what = " tls handshake timed out\n";
+    }
+#endif
+    std::cerr << "[-] " << saddr2str(m_address) << ":" << ntohs(m_address.sin_port) << what;
+}
+
+void rtsp::Connection::f_begin_reply( const Parser::Message &msg, const char *status )
+{
+    m_reply.append( "RTSP/1.0 " ).append( status ).append( "\r\n" );
+    std::string_view cseq = msg.header( "CSeq" );
+    if( !cseq.empty() )
+    {
+        m_reply.append( "CSeq: " ).append( cseq ).append( "\r\n" );
+    }
+    if( m_setup )
+    {
+        m_reply.append( "Session: " ).append( m_session ).append( ";timeout=" )
+               .append( std::to_string( SESSION_TIMEOUT.count() ) ).append( "\r\n" );
+    }
+}
+
+void rtsp::Connection::f_end_reply( std::string_view body )
+{
+    if( !body.empty() )
+    {
+        char buf[32];
+        snprintf( buf, sizeof(buf), "%zu", body.size() );
+        m_reply.append( "Content-Length: " ).append( buf ).append( "\r\n" );
+    }
+    m_reply.append( "\r\n" ).append( body );
+    f_flush();
+}
+
+void rtsp::Connection::f_reply_describe( const Parser::Message &msg )
+{
+    f_begin_reply( msg );
+    f_date();
+    m_reply.append( "Content-Base: " ).append( msg.uri ).append( "\r\n" );
+    m_reply.append( "Content-Type: application/sdp\r\n" );
+    f_end_reply( m_sdp );
+}
+
+void rtsp::Connection::f_reply_setup( const Parser::Message &msg )
+{
+    std::string_view transport = msg.header( "Transport" );
+    m_setup = true;
+
+    if( m_multicast && transport.find( "multicast" ) != std::string_view::npos )
+    {
+        m_multicast_session = true;
+        f_begin_reply( msg );
+        m_reply.append( "Transport: " ).append( m_multicast->transport() ).append( "\r\n" );
+        f_end_reply();
+        return;
+    }
+
+    // RTP/AVP;unicast;client_port=a-b - UDP, everything else is interleaved into this connection
+    unsigned rtp_port = 0, rtcp_port = 0;
+    size_t p = transport.find( "client_port=" );
+    if( m_udp && transport.find( "/TCP" ) == std::string_view::npos && p != std::string_view::npos )
+    {
+        char ports[32] = { 0 };
+        transport.copy( ports, std::min( sizeof(ports) - 1, transport.size() - p ), p );
+        if( sscanf( ports, "client_port=%u-%u", &rtp_port, &rtcp_port ) < 1 || rtp_port >= 0x10000 )
+        {
+            rtp_port = 0;
+        }
+    }
+    if( rtp_port )
+    {
+        if( !rtcp_port )
+        {
+            rtcp_port = rtp_port + 1;
+        }
+        m_udp_address = m_address;
+        m_udp_address.sin_port = htons( rtp_port );
+        m_rtcp_address = m_address;
+        m_rtcp_address.sin_port = htons( rtcp_port );
+        m_impairment.reset();
+        if( m_timers && !m_impairment_profile.empty() )
+        {
+            m_impairment.reset( new Impairment( m_impairment_profile, *m_udp, m_udp_address, *m_timers ) );
+        }
+
+        char buf[128];
+        snprintf( buf, sizeof(buf), "Transport: RTP/AVP;unicast;client_port=%u-%u;server_port=%u-%u\r\n",
+                  rtp_port, rtcp_port, unsigned(m_udp->port()), unsigned(m_udp->port() + 1) );
+        f_begin_reply( msg );
+        m_reply.append( buf );
+        f_end_reply();
+        return;
+    }
+
+    f_begin_reply( msg );
+    m_reply.append( "Transport: RTP/AVP/TCP;interleaved=0-1\r\n" );
+    f_end_reply();
 }
 
-void rtsp::Connection::f_reply_play()
+void rtsp::Connection::f_reply_play( const Parser::Message &msg )
 {
-    std::string reply = std::string("Date: ") + f_ctime() +
-                        std::string("Session: ") + m_session + "\r\n\r\n";
-    f_reply( reply.c_str() );
+    if( !m_setup )
+    {
+        f_begin_reply( msg, "455 Method Not Valid in This State" );
+        f_end_reply();
+        return;
+    }
+    f_begin_reply( msg );
+    f_date();
+    f_end_reply();
 
-    m_rtsp_sent = 0;
+    m_joined = !m_playing;
     m_playing = true;
 }
 
-std::string rtsp::Connection::f_ctime()
+void rtsp::Connection::f_reply_pause( const Parser::Message &msg )
+{
+    f_begin_reply( msg );
+    f_end_reply();
+
+    if( m_playing )
+    {
+        // PLAY resumes from a keyframe with the GOP burst
+        m_playing = false;
+        for( auto q = m_queue.begin(); q != m_queue.end(); )
+        {
+            if( q->headers.empty() )
+            {
+                m_queued -= q->frame->data.size();
+                q = m_queue.erase( q );
+            }
+            else
+            {
+                ++q;
+            }
+        }
+        m_sent_flag &= ~SENT_IDR;
+    }
+}
+
+void rtsp::Connection::f_date()
 {
     static const char *week[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
     static const char *month[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
     char buf[64];
     time_t t = time( nullptr );
 
-    struct tm * tp = gmtime( &t );
+    struct tm tm;
+    gmtime_r( &t, &tm );
     //Sun, 11 Feb 2024 08:54:05 GMT
-    sprintf( buf, "%s, %02u %s %u %02u:%02u:%02u GMT\r\n",
-             week[tp->tm_wday], tp->tm_mday, month[tp->tm_mon], tp->tm_yday + 1982, tp->tm_hour, tp->tm_min, tp->tm_sec );
-
-    return buf;
+    snprintf( buf, sizeof(buf), "Date: %s, %02u %s %u %02u:%02u:%02u GMT\r\n",
+              week[tm.tm_wday], tm.tm_mday, month[tm.tm_mon], tm.tm_year + 1900, tm.tm_hour, tm.tm_min, tm.tm_sec );
+    m_reply.append( buf );
 }
 
-bool rtsp::Connection::f_can_be_sent( uint8_t nutype )
+bool rtsp::Connection::f_can_be_sent( const rtp::Frame &frame )
 {
-    if( nutype == nal_unit_type_e::NAL_SPS )
+    if( frame.parameter_sets )
     {
-        m_sent_flag |= SENT_SPS;
-        return true;
-    }
-    if( nutype == nal_unit_type_e::NAL_PPS )
-    {
-        m_sent_flag |= SENT_PPS;
-        return true;
+        m_sent_flag |= SENT_SPS | SENT_PPS;
     }
-    if( nutype == nal_unit_type_e::NAL_SLICE_IDR && (m_sent_flag & SENT_SPS) && (m_sent_flag & SENT_PPS) )
+    // IDR или, при периодическом intra refresh, кадр начала волны обновления
+    if( (frame.nutype == nal_unit_type_e::NAL_SLICE_IDR || frame.keyframe) && (m_sent_flag & SENT_SPS) && (m_sent_flag & SENT_PPS) )
     {
         m_sent_flag |= SENT_IDR;
         return true;
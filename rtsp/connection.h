@@ -9,10 +9,19 @@
 #define RTSP_CONNECTION_H
 
 #include "rtp.h"
+#include "rtcp.h"
+#include "socket.h"
+#include "multicast.h"
+#include "parser.h"
+#include "impairment.h"
+#include "timer.h"
+#include "../options.h"
 
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <arpa/inet.h>
+#include <chrono>
+#include <deque>
 #include <memory>
 #include <string>
 #include <vector>
@@ -21,9 +30,43 @@
 
 namespace rtsp {
 
+    class Connection;
+    class TlsContext;
+    class TlsSession;
+
+    // asynchronous output (io_uring): the loop sends the batch and reports the result
+    // with Connection::on_written(), the connection keeps msg and its iovecs until then
+    class AsyncWriter {
+    public:
+        virtual ~AsyncWriter() = default;
+        virtual void write( Connection &conn, const msghdr &msg ) = 0;
+    };
+
     class Connection {
     public:
-        explicit Connection( int b_sock, const std::string &sdp );
+        static constexpr std::chrono::seconds REPORT_INTERVAL {2};
+        // no requests and no RTCP from the client for that long (the RTSP session timeout)
+        static constexpr std::chrono::seconds SESSION_TIMEOUT {60};
+        // queued output and not a byte of it written for that long: the peer is gone
+        static constexpr std::chrono::seconds SEND_TIMEOUT {10};
+        // RTSPS: the TLS handshake has to be over by then
+        static constexpr std::chrono::seconds HANDSHAKE_TIMEOUT {10};
+        // a slow client never holds more than that; the frames themselves are shared
+        static const size_t MAX_QUEUED_FRAMES = 128;
+        static const size_t MAX_QUEUED_BYTES = 8 * 1024 * 1024;
+
+        Connection( int fd,
+                    const sockaddr_in &address,
+                    const std::string &sdp,
+                    Codec codec,
+                    UdpSocket *udp = nullptr,
+                    UdpSocket *rtcp = nullptr,
+                    const Multicast *multicast = nullptr,
+                    AsyncWriter *writer = nullptr,
+                    size_t zerocopy = 0,
+                    TimerWheel *timers = nullptr,
+                    const Impairment::Profile *impairment = nullptr,
+                    const TlsContext *tls = nullptr );
         Connection(const Connection& orig) = delete;
         Connection &operator =(const Connection& orig) = delete;
         ~Connection();
@@ -34,35 +77,171 @@ namespace rtsp {
 
         void on_data( const uint8_t * data, int size );
         void on_ready_to_write();
-        void send_frame( const uint8_t *data, size_t size, size_t full_size, int delay );
+        // result of the batch handed to the AsyncWriter: bytes sent or -errno
+        void on_written( ssize_t rc );
+        // EPOLLERR: zero-copy completions from the error queue, false - the socket is broken
+        bool on_error();
+        void send_frame( const rtp::Packetized &unit );
+
+        // RTCP from the client: interleaved channel 1 or a datagram to the server RTCP port
+        void on_rtcp( const uint8_t *data, size_t size );
+        // sender report, at most once per REPORT_INTERVAL while playing
+        void report( std::chrono::steady_clock::time_point now );
+
+        // client RTCP address of an RTP over UDP session, sin_port == 0 otherwise
+        const sockaddr_in &rtcp_address() const
+        {
+            return m_rtcp_address;
+        }
+
+        // true once after PLI/FIR or a loss reported by the client
+        bool keyframe_requested()
+        {
+            bool rc = m_keyframe_requested;
+            m_keyframe_requested = false;
+            return rc;
+        }
+
+        // the session plays the shared multicast stream, rtsp::Poll sends it once for all of them
+        bool multicast() const
+        {
+            return m_multicast_session && m_playing;
+        }
+
+        // TEARDOWN or a broken request: the connection is closed once the reply is sent
+        bool closed() const
+        {
+            return m_write_failed || (m_closing && m_rtsp_sent >= m_reply.size() && !m_writing);
+        }
+
+        // the moment the session expires unless the client shows up or reads the queued output
+        std::chrono::steady_clock::time_point deadline() const;
+        // the deadline has passed, the loop closes the connection
+        void on_timeout( std::chrono::steady_clock::time_point now );
+
+        // true once after PLAY - the session has just joined the stream
+        bool joined()
+        {
+            bool rc = m_joined;
+            m_joined = false;
+            return rc;
+        }
 
     private:
         enum { SENT_NOTHING = 0, SENT_SPS = 1, SENT_PPS = 2, SENT_IDR = 4 };
+        enum { MAX_IOV = 256 };
+
+        // fraction lost (1/256) in a receiver report that makes the session skip to the next
+        // keyframe on every new loss and the one that turns it off
+        static const uint8_t LOSSY_ON = 13;     // ~5%
+        static const uint8_t LOSSY_OFF = 5;     // ~2%
+
+        // shared frame with the session's own packet headers. The headers (and so the
+        // sequence numbers) are assigned when the frame is about to be written: a frame
+        // without them can still be dropped without a gap in the sequence
+        struct Pending
+        {
+            rtp::SharedFrame frame;
+            std::vector< uint8_t > headers;
+            size_t packet {0};      // first packet not sent completely
+            size_t offset {0};      // bytes of that packet already sent
+            bool zerocopy {false};  // some of it went out with MSG_ZEROCOPY
+        };
+
+        // frames sent with MSG_ZEROCOPY: the kernel reads the buffers until the send
+        // with that id (and every earlier one) is reported complete
+        struct Pinned
+        {
+            uint32_t id;
+            std::vector< Pending > frames;
+        };
 
-        socklen_t m_socklen { sizeof(sockaddr_in) };
         int m_fd;
         sockaddr_in m_address;
-        std::string m_request;
-        std::string m_reply;
+        Parser m_parser;
+        std::string m_reply;        // replies not sent yet, the capacity is reserved once
         size_t m_rtsp_sent {0};
-        size_t m_rtp_sent {0};
+        bool m_setup {false};
+        bool m_closing {false};
+        std::chrono::steady_clock::time_point m_active;     // the last request or RTCP packet
+        std::chrono::steady_clock::time_point m_progress;   // the last write that sent anything
+
+        // the batch being written: a reply or packets of the queued frames
+        iovec m_iov[MAX_IOV];
+        msghdr m_msg {};
+        bool m_writing_reply {false};
+        size_t m_gathered {0};          // queued frames in the batch
+        std::string m_reply_out;        // copy of the reply being written by the AsyncWriter
+        AsyncWriter *m_writer;
+        bool m_writing {false};         // the batch is in the AsyncWriter
+        bool m_write_failed {false};
 
         std::string m_sdp;
         std::string m_session;
 
         bool m_playing {false};
-        std::vector< uint8_t > m_frame;
-        rtp::RTP m_rtp;
+        bool m_joined {false};
+        std::deque< Pending > m_queue;
+        size_t m_queued {0};
+        size_t m_dropped {0};
+        bool m_skipping {false};
+        Codec m_codec;
+        UdpSocket *m_udp;
+        sockaddr_in m_udp_address {};       // sin_port != 0 - the session is set up for RTP over UDP
+        std::vector< uint8_t > m_udp_headers;
+        const Multicast *m_multicast;
+        bool m_multicast_session {false};
+        rtp::Session m_rtp;
         uint8_t m_sent_flag = SENT_NOTHING;
 
-    private:
-        void f_reply( const char *reply_line );
-        void f_reply_describe();
-        void f_reply_setup();
-        void f_reply_play();
-        bool f_can_be_sent( uint8_t nutype );
+        // RTCP
+        UdpSocket *m_rtcp;
+        sockaddr_in m_rtcp_address {};
+        std::chrono::steady_clock::time_point m_reported;
+        bool m_keyframe_requested {false};
+        bool m_lossy {false};               // the client loses packets, a loss skips to the next keyframe
+        int32_t m_lost {0};                 // cumulative number of packets lost
+        uint32_t m_jitter {0};              // RTP timestamp units
+        double m_rtt {-1.};                 // ms
+        uint32_t m_nacks {0};
+
+        // MSG_ZEROCOPY
+        size_t m_zerocopy;                  // batches of at least that many bytes, 0 - off
+        uint32_t m_zerocopy_id {0};         // id of the next zero-copy send
+        std::deque< Pinned > m_pinned;
+        bool m_zerocopy_copied {false};     // the kernel fell back to copying (loopback, no SG)
 
-        std::string f_ctime();
+        // network emulation of RTP over UDP: the server-wide profile or ?impairment=... in a request url
+        TimerWheel *m_timers;
+        Impairment::Profile m_impairment_profile;
+        std::unique_ptr< Impairment > m_impairment;
+
+#ifdef WITH_TLS
+        // RTSPS: the kernel encrypts what is written, the client's records are decrypted by m_tls
+        std::unique_ptr< TlsSession > m_tls;
+        std::vector< uint8_t > m_tls_plain;
+#endif
+
+    private:
+        void f_message( const Parser::Message &msg );
+        void f_begin_reply( const Parser::Message &msg, const char *status = "200 OK" );
+        void f_end_reply( std::string_view body = std::string_view() );
+        void f_reply_describe( const Parser::Message &msg );
+        void f_reply_setup( const Parser::Message &msg );
+        void f_reply_play( const Parser::Message &msg );
+        void f_reply_pause( const Parser::Message &msg );
+        void f_date();
+        bool f_can_be_sent( const rtp::Frame &frame );
+        void f_flush();
+        size_t f_gather();
+        void f_written( size_t size );
+        ssize_t f_send_zerocopy();
+        void f_send_udp( const rtp::SharedFrame &frame );
+        void f_impairment_profile( std::string_view uri );
+        void f_drop( size_t incoming );
+        // drops the frames not started and the ones up to the next keyframe
+        void f_skip();
+        void f_feedback( const rtcp::Feedback &fb );
 };
 
 }  // namespace rtsp
@@ -0,0 +1,45 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#include "gop.h"
+#include <iostream>
+
+void rtsp::GopCache::store( const rtp::Packetized &frame )
+{
+    if( frame.stream->keyframe )
+    {
+        clear();
+    }
+    else if( m_units.empty() )
+    {
+        // без опорного кадра кэш бесполезен - ждем следующий IDR
+        return;
+    }
+
+    // a session gets one of the two packetizations
+    size_t size = frame.stream->data.size();
+    if( frame.datagram && frame.datagram->data.size() > size )
+    {
+        size = frame.datagram->data.size();
+    }
+    if( m_size + size > MAX_SIZE || m_units.size() == MAX_FRAMES )
+    {
+        if( !m_overflowed )
+        {
+            m_overflowed = true;
+            std::cerr << "[*] the group of frames is larger than the cache (" << MAX_FRAMES << " frames, "
+                      << (MAX_SIZE >> 20) << " Mb), new clients start with a requested keyframe\n";
+        }
+        clear();
+        return;
+    }
+    m_units.push_back( frame );
+    m_size += size;
+}
+
+void rtsp::GopCache::clear()
+{
+    m_units.clear();
+    m_size = 0;
+}
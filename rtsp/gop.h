@@ -0,0 +1,46 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#ifndef RTSP_GOP_H
+#define RTSP_GOP_H
+
+#include "rtp.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace rtsp {
+
+    // текущая группа кадров (IDR с SPS и PPS в STAP-A и все последующие кадры) для мгновенного старта
+    // новой сессии. Для JPEG каждый кадр ключевой, и в кэше остается только последний
+    class GopCache {
+    public:
+        // the group goes to a joining session at once and has to fit into half of its send
+        // queue (Connection::MAX_QUEUED_*), the rest is for the live frames that follow it.
+        // A larger group is not cached up to the next IDR
+        static const size_t MAX_SIZE = 4 * 1024 * 1024;
+        static const size_t MAX_FRAMES = 64;
+
+        // кадры хранятся уже упакованными в rtp
+        void store( const rtp::Packetized &frame );
+        void clear();
+
+        const std::vector< rtp::Packetized > &units() const
+        {
+            return m_units;
+        }
+        bool empty() const
+        {
+            return m_units.empty();
+        }
+
+    private:
+        std::vector< rtp::Packetized > m_units;
+        size_t m_size {0};
+        bool m_overflowed {false};      // reported once
+    };
+
+}  // namespace rtsp
+
+#endif /* RTSP_GOP_H */
@@ -0,0 +1,266 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#include "impairment.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+    bool to_double( std::string_view text, double &value, double max )
+    {
+        std::string s( text );
+        char *end = nullptr;
+        value = strtod( s.c_str(), &end );
+        return !s.empty() && *end == 0 && value >= 0. && value <= max;
+    }
+
+    bool to_int( std::string_view text, int &value )
+    {
+        double d;
+        if( !to_double( text, d, 1e9 ) || d != int(d) )
+        {
+            return false;
+        }
+        value = int(d);
+        return true;
+    }
+
+}  // namespace
+
+
+bool rtsp::Impairment::Profile::parse( std::string_view text )
+{
+    *this = Profile();
+    while( !text.empty() )
+    {
+        size_t comma = text.find( ',' );
+        std::string_view item = text.substr( 0, comma );
+        text = comma == std::string_view::npos ? std::string_view() : text.substr( comma + 1 );
+
+        size_t eq = item.find( '=' );
+        if( eq == std::string_view::npos )
+        {
+            return false;
+        }
+        std::string_view key = item.substr( 0, eq );
+        std::string_view value = item.substr( eq + 1 );
+
+        bool ok = false;
+        if( key == "loss" )
+        {
+            ok = to_double( value, loss, 100. );
+        }
+        else if( key == "burst" )
+        {
+            // burst=вход:выход, %
+            size_t colon = value.find( ':' );
+            ok = colon != std::string_view::npos &&
+                 to_double( value.substr( 0, colon ), burst_on, 100. ) &&
+                 to_double( value.substr( colon + 1 ), burst_off, 100. ) &&
+                 burst_off > 0.;
+        }
+        else if( key == "delay" )
+        {
+            ok = to_int( value, delay );
+        }
+        else if( key == "jitter" )
+        {
+            ok = to_int( value, jitter );
+        }
+        else if( key == "reorder" )
+        {
+            ok = to_double( value, reorder, 100. );
+        }
+        else if( key == "dup" )
+        {
+            ok = to_double( value, duplicate, 100. );
+        }
+        else if( key == "rate" )
+        {
+            ok = to_int( value, rate );
+        }
+        else if( key == "seed" )
+        {
+            int s = 0;
+            ok = to_int( value, s );
+            seed = s;
+        }
+        if( !ok )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool rtsp::Impairment::Profile::empty() const
+{
+    return !loss && !burst_on && !delay && !jitter && !reorder && !duplicate && !rate;
+}
+
+std::string rtsp::Impairment::Profile::str() const
+{
+    std::ostringstream s;
+    s << "loss=" << loss << ",burst=" << burst_on << ":" << burst_off << ",delay=" << delay
+      << ",jitter=" << jitter << ",reorder=" << reorder << ",dup=" << duplicate << ",rate=" << rate
+      << ",seed=" << seed;
+    return s.str();
+}
+
+
+rtsp::Impairment::Impairment( const Profile &profile, UdpSocket &udp, const sockaddr_in &address, TimerWheel &timers )
+: m_profile( profile )
+, m_udp( udp )
+, m_address( address )
+, m_timers( timers )
+, m_random( profile.seed )
+{
+    m_datagram.reserve( rtp::Header::SIZE + rtp::Packetizer::DATAGRAM_PAYLOAD_SIZE );
+    std::cerr << "[*] network impairment " << m_profile.str() << "\n";
+}
+
+rtsp::Impairment::~Impairment()
+{
+    m_timers.cancel( m_timer );
+    std::cerr << "[*] network impairment: " << m_lost << " packets lost, " << m_duplicated << " duplicated, "
+              << m_reordered << " reordered, " << m_overflow << " dropped by the rate limit\n";
+}
+
+void rtsp::Impairment::send( const uint8_t *header, const rtp::SharedFrame &frame, size_t packet, Clock::time_point now )
+{
+    // Gilbert-Elliott: в плохом состоянии теряются все пакеты
+    if( m_profile.burst_on > 0. )
+    {
+        m_bad = m_bad ? !f_chance( m_profile.burst_off ) : f_chance( m_profile.burst_on );
+    }
+    if( m_bad || f_chance( m_profile.loss ) )
+    {
+        ++m_lost;
+        return;
+    }
+
+    int copies = 1;
+    if( f_chance( m_profile.duplicate ) )
+    {
+        ++copies;
+        ++m_duplicated;
+    }
+    header += rtp::Interleaved::SIZE;
+    size_t size = frame->packet_size( packet ) - rtp::Interleaved::SIZE;
+    for( int i = 0; i < copies; ++i )
+    {
+        Clock::time_point release = now;
+        if( m_profile.rate && !f_shape( size, now, release ) )
+        {
+            ++m_overflow;
+            continue;
+        }
+        release += std::chrono::milliseconds( m_profile.delay );
+        if( m_profile.jitter )
+        {
+            release += std::chrono::microseconds( int64_t(m_percent( m_random ) * m_profile.jitter * 10) );
+        }
+        if( f_chance( m_profile.reorder ) )
+        {
+            release += REORDER_DELAY;
+            ++m_reordered;
+        }
+
+        if( release <= now )
+        {
+            f_release( now );
+            f_send( header, *frame, packet );
+        }
+        else
+        {
+            f_enqueue( header, frame, packet, release );
+        }
+    }
+    f_schedule();
+}
+
+bool rtsp::Impairment::f_chance( double percent )
+{
+    return percent > 0. && m_percent( m_random ) < percent;
+}
+
+bool rtsp::Impairment::f_shape( size_t size, Clock::time_point now, Clock::time_point &departure )
+{
+    using seconds = std::chrono::duration< double >;
+
+    double rate = m_profile.rate * 1000. / 8.;   // bytes per second
+    double depth = std::max( rate * seconds( BUCKET ).count(), double(rtp::Header::SIZE + rtp::Packetizer::DATAGRAM_PAYLOAD_SIZE) );
+
+    Clock::time_point t = std::max( now, m_bucket_time );
+    double tokens = std::min( depth, m_tokens + rate * seconds( t - m_bucket_time ).count() );
+    if( tokens < size )
+    {
+        t += std::chrono::duration_cast< Clock::duration >( seconds( (size - tokens) / rate ) );
+        tokens = size;
+    }
+    if( t - now > MAX_BACKLOG )
+    {
+        return false;
+    }
+    m_tokens = tokens - size;
+    m_bucket_time = t;
+    departure = t;
+    return true;
+}
+
+void rtsp::Impairment::f_enqueue( const uint8_t *header, const rtp::SharedFrame &frame, size_t packet, Clock::time_point release )
+{
+    Delayed d;
+    d.release = release;
+    d.order = m_order++;
+    d.frame = frame;
+    d.packet = packet;
+    memcpy( d.header, header, rtp::Header::SIZE );
+    m_queue.push( std::move( d ) );
+}
+
+void rtsp::Impairment::f_send( const uint8_t *header, const rtp::Frame &frame, size_t packet )
+{
+    const uint8_t *payload = frame.data.data() + frame.packets[packet] + rtp::Session::HEADER_SIZE;
+    size_t size = frame.packet_size( packet ) - rtp::Session::HEADER_SIZE;
+
+    m_datagram.assign( header, header + rtp::Header::SIZE );
+    m_datagram.insert( m_datagram.end(), payload, payload + size );
+    // a datagram that does not fit into the socket buffer is lost like any other udp loss
+    m_udp.send( m_address, m_datagram.data(), m_datagram.size() );
+}
+
+void rtsp::Impairment::f_release( Clock::time_point now )
+{
+    while( !m_queue.empty() && m_queue.top().release <= now )
+    {
+        const Delayed &d = m_queue.top();
+        f_send( d.header, *d.frame, d.packet );
+        m_queue.pop();
+    }
+}
+
+void rtsp::Impairment::f_schedule()
+{
+    if( m_queue.empty() )
+    {
+        m_timers.cancel( m_timer );
+        m_timer = 0;
+        return;
+    }
+    if( m_timer && m_timer_at == m_queue.top().release )
+    {
+        return;
+    }
+    m_timers.cancel( m_timer );
+    m_timer_at = m_queue.top().release;
+    m_timer = m_timers.schedule( m_timer_at, [this](){
+        m_timer = 0;
+        f_release( Clock::now() );
+        f_schedule();
+    } );
+}
@@ -0,0 +1,114 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#ifndef RTSP_IMPAIRMENT_H
+#define RTSP_IMPAIRMENT_H
+
+#include "rtp.h"
+#include "socket.h"
+#include "timer.h"
+#include <netinet/in.h>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <queue>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace rtsp {
+
+    // Network emulator in the RTP over UDP send path of one session: random and burst
+    // (Gilbert-Elliott) loss, delay with jitter, reordering, duplication and a token bucket
+    // bandwidth cap. Delayed packets are released by the loop's timer wheel. The random
+    // generator is seeded from the profile, so the same profile gives the same impairments
+    class Impairment {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        // "loss=2,burst=1:25,delay=40,jitter=20,reorder=5,dup=1,rate=1500,seed=7", all optional
+        struct Profile
+        {
+            double loss {0};            // random loss, %
+            double burst_on {0};        // per packet chance to enter the bad state (every packet lost), %
+            double burst_off {0};       // per packet chance to leave it, %
+            int delay {0};              // ms
+            int jitter {0};             // uniform extra delay 0..jitter ms, packets overtake each other
+            double reorder {0};         // packets held back by REORDER_DELAY, %
+            double duplicate {0};       // %
+            int rate {0};               // kbit/s, 0 - unlimited
+            uint32_t seed {1};
+
+            // false on an unknown key or a bad value
+            bool parse( std::string_view text );
+            bool empty() const;
+            std::string str() const;
+        };
+
+        static constexpr std::chrono::milliseconds REORDER_DELAY {10};
+        // the token bucket holds that much of the rate, a longer queue is tail-dropped like in a router
+        static constexpr std::chrono::milliseconds BUCKET {20};
+        static constexpr std::chrono::milliseconds MAX_BACKLOG {500};
+
+        Impairment( const Profile &profile, UdpSocket &udp, const sockaddr_in &address, TimerWheel &timers );
+        Impairment(const Impairment& orig) = delete;
+        Impairment &operator =(const Impairment& orig) = delete;
+        ~Impairment();
+
+        // header - rtp::Session::HEADER_SIZE bytes, the interleaved part is skipped
+        void send( const uint8_t *header, const rtp::SharedFrame &frame, size_t packet, Clock::time_point now );
+
+    private:
+        struct Delayed
+        {
+            Clock::time_point release;
+            uint64_t order;             // FIFO among the packets released at the same moment
+            rtp::SharedFrame frame;
+            size_t packet;
+            uint8_t header[rtp::Header::SIZE];
+
+            bool operator >( const Delayed &other ) const
+            {
+                return release != other.release ? release > other.release : order > other.order;
+            }
+        };
+
+        Profile m_profile;
+        UdpSocket &m_udp;
+        sockaddr_in m_address;
+        TimerWheel &m_timers;
+
+        std::mt19937 m_random;
+        std::uniform_real_distribution< double > m_percent {0., 100.};
+        bool m_bad {false};
+
+        double m_tokens {0};            // bytes
+        Clock::time_point m_bucket_time;
+
+        std::priority_queue< Delayed, std::vector< Delayed >, std::greater< Delayed > > m_queue;
+        uint64_t m_order {0};
+        uint64_t m_timer {0};
+        Clock::time_point m_timer_at;
+        std::vector< uint8_t > m_datagram;
+
+        size_t m_lost {0};
+        size_t m_duplicated {0};
+        size_t m_reordered {0};
+        size_t m_overflow {0};
+
+    private:
+        bool f_chance( double percent );
+        // the moment the packet leaves the token bucket, false - the queue is too long
+        bool f_shape( size_t size, Clock::time_point now, Clock::time_point &departure );
+        // header - the RTP header only
+        void f_enqueue( const uint8_t *header, const rtp::SharedFrame &frame, size_t packet, Clock::time_point release );
+        void f_send( const uint8_t *header, const rtp::Frame &frame, size_t packet );
+        void f_release( Clock::time_point now );
+        void f_schedule();
+    };
+
+}  // namespace rtsp
+
+#endif /* RTSP_IMPAIRMENT_H */
@@ -0,0 +1,284 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#include "loop.h"
+#include "connection.h"
+#include <pthread.h>
+#include <sched.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+    uint64_t peer_key( const sockaddr_in &address )
+    {
+        return (uint64_t(address.sin_addr.s_addr) << 16) | address.sin_port;
+    }
+
+}  // namespace
+
+
+rtsp::Loop::Loop( const Options &options, Stream &stream, size_t index )
+: m_socket( options.port, options.loops > 1 )
+, m_options( options )
+, m_stream( stream )
+, m_index( index )
+{
+    if( m_options.rtp_port )
+    {
+        m_udp.reset( new UdpSocket( m_options.rtp_port, m_options.loops > 1 ) );
+        m_rtcp.reset( new UdpSocket( m_options.rtp_port + 1, m_options.loops > 1 ) );
+    }
+    m_impairment.parse( m_options.impairment );
+#ifdef WITH_TLS
+    if( !m_options.tls_cert.empty() )
+    {
+        m_tls.reset( new TlsContext( m_options.tls_cert, m_options.tls_key ) );
+    }
+#endif
+    m_timer_fd = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC );
+    if( m_timer_fd == -1 )
+    {
+        throw std::runtime_error( std::string("[loop] timerfd failed: ") + strerror( errno ) );
+    }
+}
+
+rtsp::Loop::~Loop()
+{
+    close( m_timer_fd );
+}
+
+void rtsp::Loop::stop()
+{
+    m_running.store( false );
+    m_stream.notify( m_index );
+}
+
+void rtsp::Loop::f_pin()
+{
+    if( m_options.loops > 1 )
+    {
+        cpu_set_t cpus;
+        CPU_ZERO( &cpus );
+        CPU_SET( m_index % std::max( std::thread::hardware_concurrency(), 1u ), &cpus );
+        pthread_setaffinity_np( pthread_self(), sizeof(cpus), &cpus );
+    }
+}
+
+void rtsp::Loop::f_connect( int fd, const sockaddr_in &address, AsyncWriter *writer )
+{
+    const TlsContext *tls = nullptr;
+#ifdef WITH_TLS
+    tls = m_tls.get();
+#endif
+    std::shared_ptr< Connection > conn( new Connection( fd, address, m_stream.sdp(), m_options.codec,
+                                                        m_udp.get(), m_rtcp.get(), m_stream.multicast(), writer,
+                                                        m_options.zerocopy, &m_timers, &m_impairment, tls ) );
+    Sessions::Id id = m_sessions.insert( fd, conn );
+    Sessions::Slot &slot = *m_sessions.find( fd );
+    auto now = TimerWheel::Clock::now();
+    slot.timers[Sessions::Deadline] = m_timers.schedule( now + Connection::SEND_TIMEOUT, [this, id](){ f_deadline( id ); } );
+    slot.timers[Sessions::Report] = m_timers.schedule( now + Connection::REPORT_INTERVAL, [this, id](){ f_report( id ); } );
+}
+
+void rtsp::Loop::f_received( Connection &conn, const uint8_t *data, size_t size )
+{
+    conn.on_data( data, size );
+    if( conn.joined() )
+    {
+        f_join( conn );
+    }
+    f_register_rtcp( conn );
+}
+
+void rtsp::Loop::f_receive_rtcp( uint8_t *buffer, size_t size )
+{
+    while( true )
+    {
+        sockaddr_in address;
+        ssize_t rc = m_rtcp->receive( address, buffer, size );
+        if( rc < 0 )
+        {
+            break;
+        }
+        auto peer = m_rtcp_peers.find( peer_key( address ) );
+        Sessions::Slot *slot = peer != m_rtcp_peers.end() ? m_sessions.find( peer->second ) : nullptr;
+        if( slot )
+        {
+            slot->conn->on_rtcp( buffer, rc );
+            continue;
+        }
+
+        // with several loops the kernel may hand the datagram to a loop that does not
+        // own the session: the per-client statistics are lost, a keyframe request is not
+        rtcp::Feedback fb;
+        if( rtcp::parse( buffer, rc, 0, fb ) && fb.keyframe )
+        {
+            m_stream.request_keyframe();
+        }
+    }
+}
+
+void rtsp::Loop::f_register_rtcp( const Connection &conn )
+{
+    const sockaddr_in &address = conn.rtcp_address();
+    if( m_rtcp && address.sin_port )
+    {
+        m_rtcp_peers[peer_key( address )] = conn;
+    }
+}
+
+void rtsp::Loop::f_close( int fd )
+{
+    Sessions::Slot *slot = m_sessions.find( fd );
+    if( !slot )
+    {
+        return;
+    }
+    const sockaddr_in &address = slot->conn->rtcp_address();
+    if( address.sin_port )
+    {
+        auto peer = m_rtcp_peers.find( peer_key( address ) );
+        if( peer != m_rtcp_peers.end() && peer->second == fd )
+        {
+            m_rtcp_peers.erase( peer );
+        }
+    }
+    for( uint64_t timer : slot->timers )
+    {
+        m_timers.cancel( timer );
+    }
+    m_sessions.erase( fd );
+}
+
+void rtsp::Loop::f_send_frames()
+{
+    m_units.clear();
+    if( !m_stream.fetch( m_published, m_units ) )
+    {
+        std::cerr << "[*] loop " << m_index << " fell behind the stream\n";
+    }
+
+    int multicast = 0;
+    for( size_t i = 0; i < m_sessions.size(); )
+    {
+        Connection &conn = m_sessions[i];
+        // TEARDOWN replies that went out with the last write
+        if( conn.closed() )
+        {
+            // the last connection takes its place
+            f_close( conn );
+            continue;
+        }
+        if( conn.keyframe_requested() )
+        {
+            m_stream.request_keyframe();
+        }
+        if( conn.multicast() )
+        {
+            ++multicast;
+        }
+        for( const auto &u : m_units )
+        {
+            conn.send_frame( u.frame );
+        }
+        ++i;
+    }
+    m_stream.multicast_sessions( m_index, multicast );
+}
+
+void rtsp::Loop::f_timers()
+{
+    uint64_t count;
+    while( ::read( m_timer_fd, &count, sizeof(count) ) == -1 && errno == EINTR );
+    m_armed = TimerWheel::Clock::time_point::max();
+    m_timers.advance( TimerWheel::Clock::now() );
+}
+
+void rtsp::Loop::f_arm_timers()
+{
+    auto next = m_timers.next();
+    if( next == m_armed )
+    {
+        return;
+    }
+    // steady_clock is CLOCK_MONOTONIC, the deadline is absolute
+    itimerspec spec;
+    memset( &spec, 0, sizeof(spec) );
+    if( next != TimerWheel::Clock::time_point::max() )
+    {
+        auto ns = std::chrono::duration_cast< std::chrono::nanoseconds >( next.time_since_epoch() ).count();
+        spec.it_value.tv_sec = ns / 1000000000;
+        spec.it_value.tv_nsec = ns % 1000000000;
+        if( !spec.it_value.tv_sec && !spec.it_value.tv_nsec )
+        {
+            spec.it_value.tv_nsec = 1;
+        }
+    }
+    if( timerfd_settime( m_timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr ) == -1 )
+    {
+        std::cerr << "[-] timerfd_settime failed: " << strerror( errno ) << std::endl;
+        return;
+    }
+    m_armed = next;
+}
+
+void rtsp::Loop::f_deadline( Sessions::Id id )
+{
+    Sessions::Slot *slot = m_sessions.find_id( id );
+    if( !slot )
+    {
+        return;
+    }
+    slot->timers[Sessions::Deadline] = 0;
+    auto now = TimerWheel::Clock::now();
+    auto deadline = slot->conn->deadline();
+    if( deadline <= now )
+    {
+        slot->conn->on_timeout( now );
+        f_close( Sessions::fd( id ) );
+        return;
+    }
+    // the wheel is not touched on every request or write: the timer catches up with the
+    // deadline here, and at least every SEND_TIMEOUT notices output that got stuck since
+    deadline = std::min( deadline, now + Connection::SEND_TIMEOUT );
+    slot->timers[Sessions::Deadline] = m_timers.schedule( deadline, [this, id](){ f_deadline( id ); } );
+}
+
+void rtsp::Loop::f_report( Sessions::Id id )
+{
+    Sessions::Slot *slot = m_sessions.find_id( id );
+    if( !slot )
+    {
+        return;
+    }
+    auto now = TimerWheel::Clock::now();
+    slot->conn->report( now );
+    slot->timers[Sessions::Report] = m_timers.schedule( now + Connection::REPORT_INTERVAL, [this, id](){ f_report( id ); } );
+}
+
+static_assert( rtsp::GopCache::MAX_SIZE <= rtsp::Connection::MAX_QUEUED_BYTES / 2 &&
+               rtsp::GopCache::MAX_FRAMES <= rtsp::Connection::MAX_QUEUED_FRAMES / 2,
+               "the join burst must not overflow the send queue of the session" );
+
+void rtsp::Loop::f_join( Connection &conn )
+{
+    std::vector< rtp::Packetized > gop = m_stream.gop( m_published );
+    for( const auto &u : gop )
+    {
+        conn.send_frame( u );
+    }
+    // nothing cached (a group larger than the cache, no IDR yet): the session would wait for
+    // the encoder's own keyframe
+    if( m_options.keyframe_on_join || (gop.empty() && m_options.codec == Codec::H264) )
+    {
+        m_stream.request_keyframe();
+    }
+}
@@ -0,0 +1,85 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#ifndef RTSP_LOOP_H
+#define RTSP_LOOP_H
+
+#include "impairment.h"
+#include "sessions.h"
+#include "socket.h"
+#include "stream.h"
+#include "timer.h"
+#ifdef WITH_TLS
+#include "tls.h"
+#endif
+#include "../options.h"
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+
+namespace rtsp {
+
+    class Connection;
+    class AsyncWriter;
+
+    // One of the event loops. Every loop has its own listener (SO_REUSEPORT when there are
+    // several of them), its own connections and sends them the units published by the Stream.
+    // Session timeouts, send deadlines and RTCP reports run on the loop's timer wheel.
+    // The way the loop waits for events and does the socket I/O is up to the backend
+    class Loop {
+    public:
+        Loop( const Options &options, Stream &stream, size_t index );
+        Loop(const Loop& orig) = delete;
+        Loop &operator =(const Loop& orig) = delete;
+        virtual ~Loop();
+
+        virtual void run() = 0;
+        virtual void stop();
+
+    protected:
+        std::atomic< bool > m_running { true };
+
+        // outlives the connections: their impairment stages cancel timers on destruction
+        TimerWheel m_timers;
+        int m_timer_fd {-1};                        // timerfd, armed for the next timer of the wheel
+        TimerWheel::Clock::time_point m_armed { TimerWheel::Clock::time_point::max() };
+        Impairment::Profile m_impairment;
+#ifdef WITH_TLS
+        std::unique_ptr< TlsContext > m_tls;        // RTSPS, every connection of the loop starts with a handshake
+#endif
+
+        Socket m_socket;
+        Sessions m_sessions;
+        std::unique_ptr< UdpSocket > m_udp;
+        std::unique_ptr< UdpSocket > m_rtcp;
+        std::unordered_map< uint64_t, int > m_rtcp_peers;   // client RTCP address -> connection
+
+        Options m_options;
+        Stream &m_stream;
+        size_t m_index;
+        uint64_t m_published {0};
+        std::vector< Stream::Unit > m_units;
+
+    protected:
+        void f_pin();
+        void f_connect( int fd, const sockaddr_in &address, AsyncWriter *writer = nullptr );
+        void f_received( Connection &conn, const uint8_t *data, size_t size );
+        void f_receive_rtcp( uint8_t *buffer, size_t size );
+        virtual void f_close( int fd );
+        void f_send_frames();
+        // the timerfd fired: runs the due timers
+        void f_timers();
+        // sets the timerfd to the next timer of the wheel, called at the end of every iteration
+        void f_arm_timers();
+
+    private:
+        void f_register_rtcp( const Connection &conn );
+        void f_join( Connection &conn );
+        void f_deadline( Sessions::Id id );
+        void f_report( Sessions::Id id );
+    };
+
+}  // namespace rtsp
+
+#endif /* RTSP_LOOP_H */
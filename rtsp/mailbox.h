@@ -0,0 +1,137 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#ifndef RTSP_MAILBOX_H
+#define RTSP_MAILBOX_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace rtsp {
+
+    // Передача последнего значения от одного потока другому без блокировок и выделения памяти.
+    // Три слота: в один пишет производитель, из другого читает потребитель, третий (средний)
+    // обменивается атомарно вместе с признаком свежести. Непрочитанное значение перезаписывается
+    // следующим - потребитель всегда получает самое новое
+    template< typename T >
+    class TripleBuffer {
+    public:
+        TripleBuffer() = default;
+        TripleBuffer( const TripleBuffer& orig ) = delete;
+        TripleBuffer &operator =( const TripleBuffer& orig ) = delete;
+
+        // the producer's slot, owned by it until publish()
+        T &back()
+        {
+            return m_slots[m_back].value;
+        }
+        void publish()
+        {
+            uint8_t prev = m_middle.exchange( m_back | FRESH, std::memory_order_acq_rel );
+            m_back = prev & INDEX;
+            if( prev & FRESH )
+            {
+                m_overwritten.fetch_add( 1, std::memory_order_relaxed );
+            }
+        }
+
+        // the latest published value, owned by the consumer until the next acquire(), nullptr - nothing new
+        T *acquire()
+        {
+            if( !(m_middle.load( std::memory_order_relaxed ) & FRESH) )
+            {
+                return nullptr;
+            }
+            uint8_t prev = m_middle.exchange( m_front, std::memory_order_acq_rel );
+            m_front = prev & INDEX;
+            return &m_slots[m_front].value;
+        }
+
+        // published, but never acquired
+        uint64_t overwritten() const
+        {
+            return m_overwritten.load( std::memory_order_relaxed );
+        }
+
+    private:
+        static const uint8_t INDEX = 0x03;
+        static const uint8_t FRESH = 0x04;
+
+        struct alignas(64) Slot
+        {
+            T value;
+        };
+
+        Slot m_slots[3];
+        alignas(64) std::atomic< uint8_t > m_middle { 1 };
+        std::atomic< uint64_t > m_overwritten { 0 };
+        alignas(64) uint8_t m_back {0};     // the producer only
+        alignas(64) uint8_t m_front {2};    // the consumer only
+    };
+
+
+    // Ограниченная очередь одного производителя и одного потребителя, когда терять значения нельзя:
+    // значение вытесняется только переполнением, и тогда отбрасывается новое, а не уже стоящее в очереди
+    template< typename T, size_t N >
+    class SpscRing {
+        static_assert( N && !(N & (N - 1)), "the ring size must be a power of two" );
+
+    public:
+        SpscRing() = default;
+        SpscRing( const SpscRing& orig ) = delete;
+        SpscRing &operator =( const SpscRing& orig ) = delete;
+
+        // the free slot for the producer, nullptr - the ring is full and the value is dropped
+        T *back()
+        {
+            size_t head = m_head.load( std::memory_order_relaxed );
+            if( head - m_tail.load( std::memory_order_acquire ) == N )
+            {
+                m_dropped.fetch_add( 1, std::memory_order_relaxed );
+                return nullptr;
+            }
+            return &m_slots[head & (N - 1)].value;
+        }
+        void publish()
+        {
+            m_head.store( m_head.load( std::memory_order_relaxed ) + 1, std::memory_order_release );
+        }
+
+        // the oldest value for the consumer, owned by it until pop(), nullptr - the ring is empty
+        T *front()
+        {
+            size_t tail = m_tail.load( std::memory_order_relaxed );
+            if( tail == m_head.load( std::memory_order_acquire ) )
+            {
+                return nullptr;
+            }
+            return &m_slots[tail & (N - 1)].value;
+        }
+        void pop()
+        {
+            m_tail.store( m_tail.load( std::memory_order_relaxed ) + 1, std::memory_order_release );
+        }
+
+        // not published because the ring was full
+        uint64_t dropped() const
+        {
+            return m_dropped.load( std::memory_order_relaxed );
+        }
+
+    private:
+        struct alignas(64) Slot
+        {
+            T value;
+        };
+
+        Slot m_slots[N];
+        alignas(64) std::atomic< size_t > m_head { 0 };     // written by the producer
+        std::atomic< uint64_t > m_dropped { 0 };
+        alignas(64) std::atomic< size_t > m_tail { 0 };     // written by the consumer
+    };
+
+}  // namespace rtsp
+
+#endif /* RTSP_MAILBOX_H */
@@ -0,0 +1,75 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#include "multicast.h"
+#include <x264.h>
+#include <iostream>
+
+rtsp::Multicast::Multicast( const Options &options )
+: m_socket( 0 )
+, m_ttl( options.multicast_ttl )
+, m_codec( options.codec )
+{
+    memset( &m_group, 0, sizeof(m_group) );
+    m_group.sin_family = AF_INET;
+    m_group.sin_port = htons( options.multicast_port );
+    if( inet_pton( AF_INET, options.multicast.c_str(), &m_group.sin_addr ) != 1 || !IN_MULTICAST( ntohl( m_group.sin_addr.s_addr ) ) )
+    {
+        throw std::runtime_error( "[multicast] invalid group " + options.multicast );
+    }
+
+    uint8_t ttl = m_ttl;
+    uint8_t loop = 1;
+    if( setsockopt( m_socket, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl) ) == -1 ||
+        setsockopt( m_socket, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop) ) == -1 )
+    {
+        throw SocketError( "setsockopt" );
+    }
+    if( !options.multicast_if.empty() )
+    {
+        in_addr ifaddr;
+        if( inet_pton( AF_INET, options.multicast_if.c_str(), &ifaddr ) != 1 ||
+            setsockopt( m_socket, IPPROTO_IP, IP_MULTICAST_IF, &ifaddr, sizeof(ifaddr) ) == -1 )
+        {
+            throw SocketError( "multicast interface " + options.multicast_if );
+        }
+    }
+    std::cerr << "[*] multicast " << options.multicast << ":" << options.multicast_port << " ttl " << m_ttl << "\n";
+}
+
+std::string rtsp::Multicast::transport() const
+{
+    char buf[INET_ADDRSTRLEN];
+    inet_ntop( AF_INET, &m_group.sin_addr, buf, sizeof(buf) );
+    uint16_t port = ntohs( m_group.sin_port );
+
+    return std::string("RTP/AVP;multicast;destination=") + buf +
+           ";port=" + std::to_string( port ) + "-" + std::to_string( port + 1 ) +
+           ";ttl=" + std::to_string( m_ttl );
+}
+
+void rtsp::Multicast::send( const rtp::SharedFrame &frame )
+{
+    if( frame->packets.empty() )
+    {
+        return;
+    }
+    // h264 поток в группе начинается с ключевого кадра (SPS и PPS идут в его STAP-A)
+    if( m_codec == Codec::H264 && !m_synced )
+    {
+        if( !frame->keyframe && frame->nutype != nal_unit_type_e::NAL_SLICE_IDR )
+        {
+            return;
+        }
+        m_synced = true;
+    }
+
+    const size_t hs = rtp::Session::HEADER_SIZE;
+    m_headers.resize( frame->packets.size() * hs );
+    for( size_t i = 0; i < frame->packets.size(); ++i )
+    {
+        m_rtp.patch( m_headers.data() + i * hs, frame->data.data() + frame->packets[i] );
+    }
+    m_socket.send( m_group, *frame, m_headers.data() );
+}
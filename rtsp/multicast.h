@@ -0,0 +1,45 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#ifndef RTSP_MULTICAST_H
+#define RTSP_MULTICAST_H
+
+#include "socket.h"
+#include "rtp.h"
+#include "../options.h"
+#include <string>
+
+namespace rtsp {
+
+    // один rtp-поток на группу для всех multicast-сессий: каждый пакет отправляется ровно один раз
+    // независимо от числа зрителей
+    class Multicast {
+    public:
+        explicit Multicast( const Options &options );
+        Multicast(const Multicast& orig) = delete;
+        Multicast &operator =(const Multicast& orig) = delete;
+
+        // Transport header of the SETUP reply
+        std::string transport() const;
+
+        void send( const rtp::SharedFrame &frame );
+        // no multicast session left - the stream restarts from the next keyframe
+        void reset()
+        {
+            m_synced = false;
+        }
+
+    private:
+        UdpSocket m_socket;
+        sockaddr_in m_group;
+        int m_ttl;
+        Codec m_codec;
+        rtp::Session m_rtp;
+        std::vector< uint8_t > m_headers;
+        bool m_synced {false};
+    };
+
+}  // namespace rtsp
+
+#endif /* RTSP_MULTICAST_H */
@@ -0,0 +1,241 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#include "parser.h"
+#include <strings.h>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+    struct MethodName
+    {
+        const char *name;
+        rtsp::Parser::Method method;
+    };
+    const MethodName methods[] = {
+        { "OPTIONS",       rtsp::Parser::Method::OPTIONS },
+        { "DESCRIBE",      rtsp::Parser::Method::DESCRIBE },
+        { "SETUP",         rtsp::Parser::Method::SETUP },
+        { "PLAY",          rtsp::Parser::Method::PLAY },
+        { "PAUSE",         rtsp::Parser::Method::PAUSE },
+        { "TEARDOWN",      rtsp::Parser::Method::TEARDOWN },
+        { "GET_PARAMETER", rtsp::Parser::Method::GET_PARAMETER },
+        { "SET_PARAMETER", rtsp::Parser::Method::SET_PARAMETER }
+    };
+
+    std::string_view trim( std::string_view s )
+    {
+        while( !s.empty() && (s.front() == ' ' || s.front() == '\t') )
+        {
+            s.remove_prefix( 1 );
+        }
+        while( !s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\r') )
+        {
+            s.remove_suffix( 1 );
+        }
+        return s;
+    }
+
+}  // namespace
+
+
+std::string_view rtsp::Parser::Message::header( std::string_view name ) const
+{
+    for( size_t i = 0; i < header_count; ++i )
+    {
+        if( headers[i].name.size() == name.size() && !strncasecmp( headers[i].name.data(), name.data(), name.size() ) )
+        {
+            return headers[i].value;
+        }
+    }
+    return std::string_view();
+}
+
+
+rtsp::Parser::Parser()
+: m_buffer( BUFFER_SIZE )
+{}
+
+size_t rtsp::Parser::feed( const uint8_t *data, size_t size )
+{
+    if( m_begin )
+    {
+        // the consumed messages are not referenced anymore
+        memmove( m_buffer.data(), m_buffer.data() + m_begin, m_end - m_begin );
+        m_end -= m_begin;
+        m_scanned -= m_begin;
+        m_begin = 0;
+    }
+    if( m_failed || m_end == m_buffer.size() )
+    {
+        // what is left after next() is one incomplete message, and it does not fit
+        m_failed = true;
+        return 0;
+    }
+    size = std::min( size, m_buffer.size() - m_end );
+    memcpy( m_buffer.data() + m_end, data, size );
+    m_end += size;
+    return size;
+}
+
+bool rtsp::Parser::next( Message &msg )
+{
+    while( !m_failed )
+    {
+        const uint8_t *buf = m_buffer.data();
+        switch( m_state )
+        {
+        case State::Start:
+            // skip empty lines between the messages
+            while( m_begin < m_end && (buf[m_begin] == '\r' || buf[m_begin] == '\n') )
+            {
+                ++m_begin;
+            }
+            if( m_begin == m_end )
+            {
+                return false;
+            }
+            m_scanned = m_begin;
+            m_state = buf[m_begin] == '$' ? State::Interleaved : State::Headers;
+            break;
+
+        case State::Interleaved:
+            if( m_end - m_begin < 4 )
+            {
+                return false;
+            }
+            m_length = (size_t(buf[m_begin + 2]) << 8) | buf[m_begin + 3];
+            if( m_end - m_begin < 4 + m_length )
+            {
+                if( 4 + m_length > m_buffer.size() )
+                {
+                    m_failed = true;
+                }
+                return false;
+            }
+            msg = Message();
+            msg.interleaved = true;
+            msg.channel = buf[m_begin + 1];
+            msg.data = buf + m_begin + 4;
+            msg.size = m_length;
+            m_begin += 4 + m_length;
+            m_state = State::Start;
+            return true;
+
+        case State::Headers:
+        {
+            // the terminator is searched in the new data only
+            size_t from = m_scanned > m_begin + 3 ? m_scanned - 3 : m_begin;
+            const uint8_t *p = nullptr;
+            for( size_t i = from; i + 4 <= m_end; ++i )
+            {
+                const uint8_t *cr = (const uint8_t *)memchr( buf + i, '\r', m_end - i );
+                if( !cr || cr + 4 > buf + m_end )
+                {
+                    break;
+                }
+                if( !memcmp( cr, "\r\n\r\n", 4 ) )
+                {
+                    p = cr;
+                    break;
+                }
+                i = cr - buf;
+            }
+            if( !p )
+            {
+                m_scanned = m_end;
+                if( m_end - m_begin == m_buffer.size() )
+                {
+                    m_failed = true;
+                }
+                return false;
+            }
+            size_t headers_end = p - buf + 4;
+            msg = Message();
+            if( !f_parse_request( msg, headers_end ) )
+            {
+                m_failed = true;
+                return false;
+            }
+            m_length = 0;
+            std::string_view cl = msg.header( "Content-Length" );
+            if( !cl.empty() )
+            {
+                for( char c : cl )
+                {
+                    if( c < '0' || c > '9' )
+                    {
+                        m_failed = true;
+                        return false;
+                    }
+                    m_length = m_length * 10 + (c - '0');
+                }
+            }
+            if( headers_end - m_begin + m_length > m_buffer.size() )
+            {
+                m_failed = true;
+                return false;
+            }
+            m_scanned = headers_end;
+            m_state = State::Body;
+            break;
+        }
+
+        case State::Body:
+            if( m_end - m_scanned < m_length )
+            {
+                return false;
+            }
+            // the request is parsed again: the views may have been moved by feed()
+            f_parse_request( msg, m_scanned );
+            msg.body = std::string_view( (const char *)buf + m_scanned, m_length );
+            m_begin = m_scanned + m_length;
+            m_state = State::Start;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool rtsp::Parser::f_parse_request( Message &msg, size_t headers_end )
+{
+    std::string_view text( (const char *)m_buffer.data() + m_begin, headers_end - m_begin - 4 );
+
+    size_t eol = text.find( "\r\n" );
+    std::string_view line = text.substr( 0, eol );
+    size_t sp1 = line.find( ' ' );
+    size_t sp2 = line.rfind( ' ' );
+    if( sp1 == std::string_view::npos || sp2 == sp1 || line.substr( sp2 + 1, 5 ) != "RTSP/" )
+    {
+        return false;
+    }
+    msg.method_name = line.substr( 0, sp1 );
+    msg.uri = trim( line.substr( sp1 + 1, sp2 - sp1 - 1 ) );
+    msg.method = Method::Unknown;
+    for( const auto &m : methods )
+    {
+        if( msg.method_name == m.name )
+        {
+            msg.method = m.method;
+            break;
+        }
+    }
+
+    msg.header_count = 0;
+    while( eol != std::string_view::npos && msg.header_count < MAX_HEADERS )
+    {
+        text.remove_prefix( eol + 2 );
+        eol = text.find( "\r\n" );
+        line = text.substr( 0, eol );
+        size_t colon = line.find( ':' );
+        if( colon != std::string_view::npos )
+        {
+            msg.headers[msg.header_count].name = trim( line.substr( 0, colon ) );
+            msg.headers[msg.header_count].value = trim( line.substr( colon + 1 ) );
+            ++msg.header_count;
+        }
+    }
+    return true;
+}
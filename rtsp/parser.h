@@ -0,0 +1,82 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#ifndef RTSP_PARSER_H
+#define RTSP_PARSER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace rtsp {
+
+    // Incremental parser of the client side of an rtsp connection: pipelined requests and
+    // interleaved ($) binary packets. The data is kept in one preallocated buffer, the
+    // parsed message refers to it and stays valid until the next feed()
+    class Parser {
+    public:
+        static const size_t BUFFER_SIZE = 16 * 1024;
+        static const size_t MAX_HEADERS = 32;
+
+        enum class Method { OPTIONS, DESCRIBE, SETUP, PLAY, PAUSE, TEARDOWN, GET_PARAMETER, SET_PARAMETER, Unknown };
+
+        struct Header
+        {
+            std::string_view name;
+            std::string_view value;
+        };
+
+        struct Message
+        {
+            bool interleaved {false};
+
+            // request
+            Method method {Method::Unknown};
+            std::string_view method_name;
+            std::string_view uri;
+            std::string_view body;
+            Header headers[MAX_HEADERS];
+            size_t header_count {0};
+
+            // interleaved packet
+            uint8_t channel {0};
+            const uint8_t *data {nullptr};
+            size_t size {0};
+
+            // case-insensitive, empty if there is no such header
+            std::string_view header( std::string_view name ) const;
+        };
+
+        Parser();
+
+        // takes as much of the data as fits into the buffer, the rest is fed again once next()
+        // has consumed the complete messages. 0 - the peer sends garbage or a message larger
+        // than the buffer
+        size_t feed( const uint8_t *data, size_t size );
+        // the next complete message, false if more data is needed
+        bool next( Message &msg );
+        bool failed() const
+        {
+            return m_failed;
+        }
+
+    private:
+        enum class State { Start, Interleaved, Headers, Body };
+
+        std::vector< uint8_t > m_buffer;
+        size_t m_begin {0};     // start of the message being parsed
+        size_t m_end {0};       // end of the received data
+        size_t m_scanned {0};   // headers are searched for the terminator from here
+        size_t m_length {0};    // interleaved payload or body length
+        State m_state {State::Start};
+        bool m_failed {false};
+
+    private:
+        bool f_parse_request( Message &msg, size_t headers_end );
+    };
+
+}  // namespace rtsp
+
+#endif /* RTSP_PARSER_H */
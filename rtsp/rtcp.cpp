@@ -0,0 +1,153 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#include "rtcp.h"
+#include <endian.h>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+    const uint64_t NTP_UNIX_OFFSET = 2208988800ULL;   // 1900 -> 1970
+
+    void put16( uint8_t *p, uint16_t v )
+    {
+        v = htobe16( v );
+        memcpy( p, &v, sizeof(v) );
+    }
+    void put32( uint8_t *p, uint32_t v )
+    {
+        v = htobe32( v );
+        memcpy( p, &v, sizeof(v) );
+    }
+    uint16_t get16( const uint8_t *p )
+    {
+        uint16_t v;
+        memcpy( &v, p, sizeof(v) );
+        return be16toh( v );
+    }
+    uint32_t get32( const uint8_t *p )
+    {
+        uint32_t v;
+        memcpy( &v, p, sizeof(v) );
+        return be32toh( v );
+    }
+
+}  // namespace
+
+
+uint64_t rtcp::ntp_now()
+{
+    auto us = std::chrono::duration_cast< std::chrono::microseconds >( std::chrono::system_clock::now().time_since_epoch() ).count();
+    uint64_t sec = us / 1000000 + NTP_UNIX_OFFSET;
+    uint64_t frac = (uint64_t(us % 1000000) << 32) / 1000000;
+    return (sec << 32) | frac;
+}
+
+size_t rtcp::sender_report( uint8_t *out,
+                            uint32_t ssrc,
+                            uint64_t ntp,
+                            uint32_t rtp_timestamp,
+                            uint32_t packets,
+                            uint32_t octets,
+                            const std::string &cname )
+{
+    // SR without report blocks
+    out[0] = 0x80;
+    out[1] = SR;
+    put16( out + 2, 6 );
+    put32( out + 4, ssrc );
+    put32( out + 8, ntp >> 32 );
+    put32( out + 12, uint32_t(ntp) );
+    put32( out + 16, rtp_timestamp );
+    put32( out + 20, packets );
+    put32( out + 24, octets );
+
+    // SDES with one CNAME item, padded to 32 bits
+    uint8_t *sdes = out + 28;
+    size_t len = std::min( cname.size(), size_t(MAX_SIZE - 28 - 12) );
+    size_t chunk = 4 + 2 + len + 1;
+    size_t padded = (chunk + 3) & ~size_t(3);
+    sdes[0] = 0x81;
+    sdes[1] = SDES;
+    put16( sdes + 2, padded / 4 );
+    put32( sdes + 4, ssrc );
+    sdes[8] = 1;    // CNAME
+    sdes[9] = len;
+    memcpy( sdes + 10, cname.data(), len );
+    memset( sdes + 10 + len, 0, padded - (chunk - 1) );
+
+    return 28 + 4 + padded;
+}
+
+bool rtcp::parse( const uint8_t *data, size_t size, uint32_t ssrc, Feedback &fb )
+{
+    bool valid = false;
+    while( size >= 4 )
+    {
+        if( (data[0] >> 6) != 2 )
+        {
+            return valid;
+        }
+        uint8_t count = data[0] & 0x1f;
+        uint8_t type = data[1];
+        size_t len = (size_t(get16( data + 2 )) + 1) * 4;
+        if( len > size )
+        {
+            return valid;
+        }
+        valid = true;
+
+        // report blocks follow the sender info in SR and the sender SSRC in RR
+        size_t blocks = type == SR ? 28 : (type == RR ? 8 : 0);
+        if( blocks )
+        {
+            for( uint8_t i = 0; i < count && blocks + 24 <= len; ++i, blocks += 24 )
+            {
+                const uint8_t *b = data + blocks;
+                if( ssrc && get32( b ) != ssrc )
+                {
+                    continue;
+                }
+                fb.report = true;
+                fb.fraction_lost = b[4];
+                int32_t lost = (int32_t(b[5]) << 16) | (int32_t(b[6]) << 8) | b[7];
+                fb.cumulative_lost = (lost & 0x800000) ? lost - 0x1000000 : lost;
+                fb.jitter = get32( b + 12 );
+                fb.lsr = get32( b + 16 );
+                fb.dlsr = get32( b + 20 );
+            }
+        }
+        else if( len >= 12 && (type == RTPFB || type == PSFB) && (!ssrc || get32( data + 8 ) == ssrc || type == PSFB) )
+        {
+            if( type == RTPFB && count == 1 )
+            {
+                // generic NACK: PID + bitmask of the following lost packets
+                for( size_t off = 12; off + 4 <= len; off += 4 )
+                {
+                    fb.nacks += 1 + __builtin_popcount( get16( data + off + 2 ) );
+                }
+            }
+            else if( type == PSFB && (count == 1 || count == 4) )
+            {
+                // PLI or FIR
+                fb.keyframe = true;
+            }
+        }
+        data += len;
+        size -= len;
+    }
+    return valid;
+}
+
+double rtcp::rtt_ms( const Feedback &fb, uint64_t ntp )
+{
+    if( !fb.report || !fb.lsr )
+    {
+        return -1.;
+    }
+    uint32_t now = uint32_t(ntp >> 16);
+    int32_t rtt = int32_t(now - fb.lsr - fb.dlsr);
+    return rtt < 0 ? 0. : rtt * 1000. / 65536.;
+}
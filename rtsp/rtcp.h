@@ -0,0 +1,53 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#ifndef VIDEOTESTS_RTCP_H
+#define VIDEOTESTS_RTCP_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace rtcp {
+
+    enum Type { SR = 200, RR = 201, SDES = 202, BYE = 203, RTPFB = 205, PSFB = 206 };
+
+    static const size_t MAX_SIZE = 256;
+
+    // 64-bit NTP timestamp of the wall clock
+    uint64_t ntp_now();
+
+    // SR + SDES CNAME compound packet, returns its size (out must hold MAX_SIZE bytes)
+    size_t sender_report( uint8_t *out,
+                          uint32_t ssrc,
+                          uint64_t ntp,
+                          uint32_t rtp_timestamp,
+                          uint32_t packets,
+                          uint32_t octets,
+                          const std::string &cname );
+
+    // what the client reports about the media source
+    struct Feedback
+    {
+        bool report {false};        // a report block for the source
+        uint8_t fraction_lost {0};  // 1/256 since the previous report
+        int32_t cumulative_lost {0};
+        uint32_t jitter {0};        // RTP timestamp units
+        uint32_t lsr {0};
+        uint32_t dlsr {0};
+        uint32_t nacks {0};         // lost packets asked for by generic NACKs
+        bool keyframe {false};      // PLI or FIR
+    };
+
+    // parses a compound packet, only the blocks about ssrc (0 - any) are taken
+    bool parse( const uint8_t *data, size_t size, uint32_t ssrc, Feedback &fb );
+
+    // round trip from LSR/DLSR of a report block, negative if unknown
+    double rtt_ms( const Feedback &fb, uint64_t ntp );
+
+}  // namespace rtcp
+
+
+#endif //VIDEOTESTS_RTCP_H
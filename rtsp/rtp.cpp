@@ -3,34 +3,54 @@
 //
 
 #include "rtp.h"
+#include <algorithm>
 
-size_t rtp::RTP::expected_size( size_t size )
+std::shared_ptr< rtp::Frame > rtp::Packetizer::f_frame( const uint8_t *data, size_t full_size, bool keyframe )
 {
-    size_t rc = 0;
-    if( size < FU_SIZE )
+    std::shared_ptr< Frame > fr( new Frame );
+    fr->data.resize( full_size );
+    fr->nutype = (*data) & 0x1f;
+    fr->keyframe = keyframe;
+    return fr;
+}
+
+void rtp::Packetizer::f_index( Frame &frame )
+{
+    for( size_t off = 0; off + Interleaved::SIZE <= frame.data.size(); )
     {
-        rc = Interleaved::SIZE + Header::SIZE + size;
+        frame.packets.push_back( off );
+        uint16_t sz;
+        memcpy( &sz, frame.data.data() + off + 2, sizeof(sz) );
+        off += Interleaved::SIZE + be16toh( sz );
     }
-    else
-    {
-        --size; // первый пакет - naluheader перезаписывается fu-indicator-ом
+}
 
-        size_t off = 0;
-        while( off < size )
+size_t rtp::RTP::expected_size( size_t size, size_t sps, size_t pps ) const
+{
+    const size_t hs = Interleaved::SIZE + Header::SIZE;
+    size_t rc = 0;
+    if( sps && pps )
+    {
+        size_t stap = STAP_HEADER_SIZE + STAP_LENGTH_SIZE + sps + STAP_LENGTH_SIZE + pps;
+        if( stap + STAP_LENGTH_SIZE + size <= m_payload_size )
         {
-            size_t sz = size >= off + FU_SIZE ? FU_SIZE : size - off;
-
-            rc += Interleaved::SIZE + Header::SIZE + FU::SIZE + sz;
-            off += sz;
+            return hs + stap + STAP_LENGTH_SIZE + size;
         }
+        rc = hs + stap;
     }
-
-    return rc;
+    if( size <= m_payload_size )
+    {
+        return rc + hs + size;
+    }
+    // первый пакет - naluheader перезаписывается fu-indicator-ом
+    size_t fragment = m_payload_size - FU::SIZE;
+    size_t fragments = (size - 1 + fragment - 1) / fragment;
+    return rc + fragments * (hs + FU::SIZE) + size - 1;
 }
 
 void rtp::RTP::serialize( const uint8_t *data, size_t size, uint8_t *frame, int delay )
 {
-    if( size < FU_SIZE )
+    if( size <= m_payload_size )
     {
         m_interleaved.serialize( frame, Header::SIZE + size );
         m_header.serialize( frame + Interleaved::SIZE, delay, true );
@@ -43,15 +63,15 @@ void rtp::RTP::serialize( const uint8_t *data, size_t size, uint8_t *frame, int
         ++data;
         --size;
 
-        size_t i = 0;
+        const size_t fragment = m_payload_size - FU::SIZE;
         size_t off = 0;
         while( off < size )
         {
-            size_t sz = size >= off + FU_SIZE ? FU_SIZE : size - off;
+            size_t sz = size >= off + fragment ? fragment : size - off;
 
             m_interleaved.serialize( frame, Header::SIZE + FU::SIZE + sz );
             frame += Interleaved::SIZE;
-            m_header.serialize( frame, delay, off + sz == size );
+            m_header.serialize( frame, off + sz == size ? delay : 0, off + sz == size );
             frame += Header::SIZE;
             fu.serialize( frame, off + sz == size );
             frame += FU::SIZE;
@@ -61,4 +81,225 @@ void rtp::RTP::serialize( const uint8_t *data, size_t size, uint8_t *frame, int
             frame += sz;
         }
     }
-}
\ No newline at end of file
+}
+
+rtp::SharedFrame rtp::RTP::packetize( const uint8_t *data,
+                                      size_t size,
+                                      int delay,
+                                      bool keyframe,
+                                      const std::vector< uint8_t > &sps,
+                                      const std::vector< uint8_t > &pps )
+{
+    bool ps = !sps.empty() && !pps.empty();
+    auto fr = f_frame( data, expected_size( size, ps ? sps.size() : 0, ps ? pps.size() : 0 ), keyframe );
+    uint8_t *frame = fr->data.data();
+
+    if( ps )
+    {
+        const std::vector< uint8_t > *units[] = { &sps, &pps };
+        size_t stap = STAP_HEADER_SIZE + STAP_LENGTH_SIZE + sps.size() + STAP_LENGTH_SIZE + pps.size();
+        // срез целиком помещается в тот же пакет - весь кадр уходит одним STAP-A
+        bool whole = stap + STAP_LENGTH_SIZE + size <= m_payload_size;
+        if( whole )
+        {
+            stap += STAP_LENGTH_SIZE + size;
+        }
+
+        m_interleaved.serialize( frame, Header::SIZE + stap );
+        frame += Interleaved::SIZE;
+        m_header.serialize( frame, whole ? delay : 0, whole );
+        frame += Header::SIZE;
+
+        // F = 0, NRI - максимальный из агрегированных NAL, type = 24
+        uint8_t nri = (sps[0] | pps[0] | (whole ? data[0] : 0)) & 0x60;
+        *frame ++ = nri | 24;
+        for( auto u : units )
+        {
+            *frame ++ = u->size() >> 8;
+            *frame ++ = u->size();
+            memcpy( frame, u->data(), u->size() );
+            frame += u->size();
+        }
+        if( whole )
+        {
+            *frame ++ = size >> 8;
+            *frame ++ = size;
+            memcpy( frame, data, size );
+        }
+        else
+        {
+            serialize( data, size, frame, delay );
+        }
+        fr->parameter_sets = true;
+    }
+    else
+    {
+        serialize( data, size, frame, delay );
+    }
+    f_index( *fr );
+    return fr;
+}
+
+bool rtp::JPEG::Image::parse( const uint8_t *data, size_t size )
+{
+    if( size < 4 || data[0] != 0xff || data[1] != 0xd8 )
+    {
+        return false;
+    }
+
+    size_t off = 2;
+    while( off + 4 <= size )
+    {
+        if( data[off] != 0xff )
+        {
+            return false;
+        }
+        uint8_t marker = data[off + 1];
+        size_t len = (size_t(data[off + 2]) << 8) | data[off + 3];
+        if( len < 2 || off + 2 + len > size )
+        {
+            return false;
+        }
+        const uint8_t *seg = data + off + 4;
+        size_t seg_size = len - 2;
+
+        switch( marker )
+        {
+            case 0xdb: // DQT
+                for( size_t i(0); i + 65 <= seg_size && table_count < 4; i += 65 )
+                {
+                    if( seg[i] >> 4 ) // только 8-битные таблицы
+                    {
+                        return false;
+                    }
+                    tables[table_count++] = seg + i + 1;
+                }
+                break;
+            case 0xc0: // SOF0
+                if( seg_size < 8 )
+                {
+                    return false;
+                }
+                height = ((size_t(seg[1]) << 8) | seg[2]) / 8;
+                width = ((size_t(seg[3]) << 8) | seg[4]) / 8;
+                type = seg[7] == 0x21 ? 0 : 1; // 4:2:2 или 4:2:0
+                break;
+            case 0xdd: // DRI
+                if( seg_size < 2 )
+                {
+                    return false;
+                }
+                restart_interval = (uint16_t(seg[0]) << 8) | seg[1];
+                break;
+            case 0xda: // SOS
+                scan = data + off + 2 + len;
+                scan_size = size - (off + 2 + len);
+                if( scan_size >= 2 && data[size - 2] == 0xff && data[size - 1] == 0xd9 )
+                {
+                    scan_size -= 2;
+                }
+                if( restart_interval )
+                {
+                    type |= 0x40;
+                }
+                return width && height && scan_size;
+        }
+        off += 2 + len;
+    }
+    return false;
+}
+
+size_t rtp::JPEG::Image::headers_size( size_t offset ) const
+{
+    return HEADER_SIZE +
+           (restart_interval ? RESTART_HEADER_SIZE : 0) +
+           (offset ? 0 : QUANT_HEADER_SIZE + 64 * table_count);
+}
+
+size_t rtp::JPEG::expected_size( const uint8_t *data, size_t size ) const
+{
+    Image img;
+    if( !img.parse( data, size ) )
+    {
+        return 0;
+    }
+
+    size_t rc = 0;
+    size_t off = 0;
+    while( off < img.scan_size )
+    {
+        size_t hs = img.headers_size( off );
+        size_t sz = std::min( m_payload_size - hs, img.scan_size - off );
+
+        rc += Interleaved::SIZE + Header::SIZE + hs + sz;
+        off += sz;
+    }
+    return rc;
+}
+
+void rtp::JPEG::serialize( const uint8_t *data, size_t size, uint8_t *frame, int delay )
+{
+    Image img;
+    if( !img.parse( data, size ) )
+    {
+        return;
+    }
+
+    size_t off = 0;
+    while( off < img.scan_size )
+    {
+        size_t hs = img.headers_size( off );
+        size_t sz = std::min( m_payload_size - hs, img.scan_size - off );
+        bool last = off + sz == img.scan_size;
+
+        m_interleaved.serialize( frame, Header::SIZE + hs + sz );
+        frame += Interleaved::SIZE;
+        m_header.serialize( frame, last ? delay : 0, last );
+        frame += Header::SIZE;
+
+        *frame ++ = 0;          // type-specific
+        *frame ++ = off >> 16;  // fragment offset
+        *frame ++ = off >> 8;
+        *frame ++ = off;
+        *frame ++ = img.type;
+        *frame ++ = 255;        // Q: таблицы передаются в первом фрагменте
+        *frame ++ = img.width;
+        *frame ++ = img.height;
+        if( img.restart_interval )
+        {
+            *frame ++ = img.restart_interval >> 8;
+            *frame ++ = img.restart_interval;
+            *frame ++ = 0xff;   // F = 1, L = 1, restart count = 0x3fff
+            *frame ++ = 0xff;
+        }
+        if( !off )
+        {
+            uint16_t length = 64 * img.table_count;
+            *frame ++ = 0;      // MBZ
+            *frame ++ = 0;      // precision
+            *frame ++ = length >> 8;
+            *frame ++ = length;
+            for( size_t i(0); i < img.table_count; ++i )
+            {
+                memcpy( frame, img.tables[i], 64 );
+                frame += 64;
+            }
+        }
+        memcpy( frame, img.scan + off, sz );
+        frame += sz;
+        off += sz;
+    }
+}
+
+rtp::SharedFrame rtp::JPEG::packetize( const uint8_t *data,
+                                       size_t size,
+                                       int delay,
+                                       bool keyframe,
+                                       const std::vector< uint8_t > &,
+                                       const std::vector< uint8_t > & )
+{
+    auto fr = f_frame( data, expected_size( data, size ), keyframe );
+    serialize( data, size, fr->data.data(), delay );
+    f_index( *fr );
+    return fr;
+}
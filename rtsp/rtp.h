@@ -5,11 +5,14 @@
 #ifndef VIDEOTESTS_RTP_H
 #define VIDEOTESTS_RTP_H
 
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <limits>
+#include <memory>
+#include <vector>
 
 namespace rtp {
 
@@ -61,6 +64,7 @@ namespace rtp {
     class Header {
     public:
         static const size_t SIZE = 12;
+        static const uint32_t CLOCK_RATE = 90000;   // video clock, the frame delay is in ms
 
         Header( uint8_t pt = 96 ) : m_pt( pt )
         {}
@@ -88,7 +92,7 @@ namespace rtp {
             uint32_t ts = htobe32( m_timestamp );
             ::memcpy( data, &ts, sizeof(ts) );
             data += sizeof(ts);
-            m_timestamp += delay;
+            m_timestamp += delay * (CLOCK_RATE / 1000);
 
             ::memcpy( data, &m_ssrc, sizeof(m_ssrc) );
         }
@@ -99,17 +103,199 @@ namespace rtp {
         uint32_t m_ssrc = rand();
     };
 
-    class RTP {
+    // access unit packetized once and shared by all sessions. Every packet starts with the
+    // interleaved header followed by the RTP header, the sessions patch their own copies of both
+    struct Frame
+    {
+        std::vector< uint8_t > data;
+        std::vector< uint32_t > packets;    // packet offsets in data
+        uint8_t nutype {0};
+        bool keyframe {false};
+        bool parameter_sets {false};        // SPS and PPS are aggregated ahead of the slice (STAP-A)
+
+        size_t packet_size( size_t i ) const
+        {
+            return (i + 1 < packets.size() ? packets[i + 1] : data.size()) - packets[i];
+        }
+    };
+    using SharedFrame = std::shared_ptr< const Frame >;
+
+    // the same access unit packetized for RTSP over TCP (large packets) and for RTP over UDP
+    // (MTU-sized packets). The latter is null when the server has no UDP transport
+    struct Packetized
+    {
+        SharedFrame stream;
+        SharedFrame datagram;
+
+        const SharedFrame &get( bool udp ) const
+        {
+            return udp ? datagram : stream;
+        }
+    };
+
+    // per-session part of the packet headers: channel, sequence number, timestamp offset and SSRC
+    class Session {
     public:
-        static const size_t FU_SIZE = 1460;
+        static const size_t HEADER_SIZE = Interleaved::SIZE + Header::SIZE;
+
+        explicit Session( uint8_t ch = 0 ): m_channel( ch )
+        {}
 
-        static size_t expected_size( size_t size );
+        void patch( uint8_t *header, const uint8_t *packet )
+        {
+            ::memcpy( header, packet, HEADER_SIZE );
+            header[1] = m_channel;
+
+            uint16_t sn = htobe16( m_seqnum++ );
+            ::memcpy( header + Interleaved::SIZE + 2, &sn, sizeof(sn) );
 
-        void serialize( const uint8_t *data, size_t size, uint8_t *frame, int delay );
+            uint32_t ts;
+            ::memcpy( &ts, header + Interleaved::SIZE + 4, sizeof(ts) );
+            ts = htobe32( be32toh( ts ) + m_timestamp );
+            ::memcpy( header + Interleaved::SIZE + 4, &ts, sizeof(ts) );
+
+            ::memcpy( header + Interleaved::SIZE + 8, &m_ssrc, sizeof(m_ssrc) );
+
+            // sender statistics for RTCP
+            uint16_t len;
+            ::memcpy( &len, packet + 2, sizeof(len) );
+            ++m_packets;
+            m_octets += be16toh( len ) - Header::SIZE;
+            ts = be32toh( ts );
+            if( m_packets == 1 || ts != m_last_timestamp )
+            {
+                m_last_timestamp = ts;
+                m_last_time = std::chrono::steady_clock::now();
+            }
+        }
+
+        uint32_t ssrc() const
+        {
+            return be32toh( m_ssrc );
+        }
+        uint32_t packets() const
+        {
+            return m_packets;
+        }
+        uint32_t octets() const
+        {
+            return m_octets;
+        }
+        // RTP timestamp corresponding to the moment now, extrapolated from the last frame
+        uint32_t timestamp( std::chrono::steady_clock::time_point now ) const
+        {
+            auto ms = std::chrono::duration_cast< std::chrono::milliseconds >( now - m_last_time ).count();
+            return m_last_timestamp + uint32_t(ms) * (Header::CLOCK_RATE / 1000);
+        }
 
     private:
+        uint8_t m_channel;
+        uint16_t m_seqnum = rand();
+        uint32_t m_timestamp = rand();
+        uint32_t m_ssrc = rand();
+
+        uint32_t m_packets {0};
+        uint32_t m_octets {0};
+        uint32_t m_last_timestamp {0};
+        std::chrono::steady_clock::time_point m_last_time;
+    };
+
+    class Packetizer {
+    public:
+        // RTP payload limits: an Ethernet MTU minus IP/UDP headers with some room for tunnels, and
+        // for RTSP over TCP - the 16-bit length of the interleaved header
+        static const size_t DATAGRAM_PAYLOAD_SIZE = 1400;
+        static const size_t STREAM_PAYLOAD_SIZE = 64000;
+
+        Packetizer( uint8_t pt, size_t payload_size ): m_header( pt ), m_payload_size( payload_size )
+        {}
+        virtual ~Packetizer() = default;
+
+        virtual void serialize( const uint8_t *data, size_t size, uint8_t *frame, int delay ) = 0;
+
+        // serializes the access unit into a frame shared by all sessions,
+        // sps and pps (H.264 only, may be empty) go in-band ahead of it
+        virtual SharedFrame packetize( const uint8_t *data,
+                                       size_t size,
+                                       int delay,
+                                       bool keyframe,
+                                       const std::vector< uint8_t > &sps,
+                                       const std::vector< uint8_t > &pps ) = 0;
+
+        size_t payload_size() const
+        {
+            return m_payload_size;
+        }
+
+    protected:
         Interleaved m_interleaved;
         Header m_header;
+        size_t m_payload_size;
+
+    protected:
+        static std::shared_ptr< Frame > f_frame( const uint8_t *data, size_t full_size, bool keyframe );
+        // packet offsets from the interleaved headers of the serialized frame
+        static void f_index( Frame &frame );
+    };
+
+    // H.264 (RFC 6184): single NAL unit packets and FU-A, parameter sets of a keyframe are
+    // aggregated into one STAP-A packet (together with the slice when it fits)
+    class RTP: public Packetizer {
+    public:
+        static const size_t STAP_HEADER_SIZE = 1;
+        static const size_t STAP_LENGTH_SIZE = 2;
+
+        explicit RTP( size_t payload_size = STREAM_PAYLOAD_SIZE ): Packetizer( 96, payload_size )
+        {}
+
+        // sps and pps are the sizes of the parameter sets, 0 - none
+        size_t expected_size( size_t size, size_t sps = 0, size_t pps = 0 ) const;
+
+        void serialize( const uint8_t *data, size_t size, uint8_t *frame, int delay ) override;
+        SharedFrame packetize( const uint8_t *data,
+                               size_t size,
+                               int delay,
+                               bool keyframe,
+                               const std::vector< uint8_t > &sps,
+                               const std::vector< uint8_t > &pps ) override;
+    };
+
+    // JPEG (RFC 2435): baseline JFIF image is split into fragments of the entropy-coded scan,
+    // quantization tables go in-band (Q = 255) with the first fragment
+    class JPEG: public Packetizer {
+    public:
+        static const size_t HEADER_SIZE = 8;
+        static const size_t RESTART_HEADER_SIZE = 4;
+        static const size_t QUANT_HEADER_SIZE = 4;
+
+        explicit JPEG( size_t payload_size = STREAM_PAYLOAD_SIZE ): Packetizer( 26, payload_size )
+        {}
+
+        size_t expected_size( const uint8_t *data, size_t size ) const;
+
+        void serialize( const uint8_t *data, size_t size, uint8_t *frame, int delay ) override;
+        SharedFrame packetize( const uint8_t *data,
+                               size_t size,
+                               int delay,
+                               bool keyframe,
+                               const std::vector< uint8_t > &sps,
+                               const std::vector< uint8_t > &pps ) override;
+
+    private:
+        struct Image
+        {
+            uint8_t type {0};
+            uint8_t width {0};
+            uint8_t height {0};
+            uint16_t restart_interval {0};
+            const uint8_t *tables[4] {};
+            size_t table_count {0};
+            const uint8_t *scan {nullptr};
+            size_t scan_size {0};
+
+            bool parse( const uint8_t *data, size_t size );
+            size_t headers_size( size_t offset ) const;
+        };
     };
 }  // namespace rtp
 
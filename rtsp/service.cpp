@@ -6,11 +6,57 @@
  */
 
 #include "service.h"
+#ifdef WITH_IO_URING
+#include "uring.h"
+#endif
+#include <algorithm>
 
-rtsp::Service::Service( uint16_t port, int fps )
-: m_poll( port, fps )
-, m_poll_thread( &m_poll )
-{}
+rtsp::Service::Service( const Options &options, int fps, Governor *governor )
+: m_stream( options, fps, std::max( options.loops, 1 ), governor )
+, m_stream_thread( &m_stream )
+{
+#ifndef WITH_IO_URING
+    if( options.io_uring )
+    {
+        std::cerr << "[*] built without io_uring, using epoll\n";
+    }
+#endif
+    for( int i = 0; i < std::max( options.loops, 1 ); ++i )
+    {
+#ifdef WITH_IO_URING
+        if( options.io_uring )
+        {
+            try
+            {
+                m_loops.emplace_back( new Uring( options, m_stream, i ) );
+                continue;
+            }
+            catch( const UringError &err )
+            {
+                std::cerr << err.what() << ", using epoll\n";
+            }
+        }
+#endif
+        m_loops.emplace_back( new Poll( options, m_stream, i ) );
+    }
+    for( auto &l : m_loops )
+    {
+        m_loop_threads.emplace_back( new ScopedThread< Loop >( l.get() ) );
+    }
+    if( options.loops > 1 )
+    {
+        std::cerr << "[*] " << options.loops << " event loops\n";
+    }
+    if( m_stream.segmenter() )
+    {
+        m_http.reset( new http::Server( options, *m_stream.segmenter() ) );
+        m_http_thread.reset( new ScopedThread< http::Server >( m_http.get() ) );
+    }
+}
 
 rtsp::Service::~Service()
-{}
+{
+    // the loops go first, they read what the stream publishes
+    m_http_thread.reset();
+    m_loop_threads.clear();
+}
@@ -9,8 +9,12 @@
 #define RTSP_SERVICE_H
 
 #include "poll.h"
+#include "stream.h"
+#include "../http/server.h"
 #include <thread>
 #include <iostream>
+#include <memory>
+#include <vector>
 
 namespace rtsp {
 
@@ -42,20 +46,25 @@ namespace rtsp {
 
     class Service {
     public:
-        explicit Service( uint16_t port, int fps );
+        Service( const Options &options, int fps, Governor *governor = nullptr );
 
         Service(const Service& orig) = delete;
         Service &operator =(const Service& orig) = delete;
         ~Service();
 
+        // the pixels are shared with the stream, not copied: the caller never writes into them again
         void store( cv::Mat frame, int delay )
         {
-            m_poll.store( frame, delay );
+            m_stream.store( frame, delay );
         }
 
     private:
-        Poll m_poll;
-        ScopedThread< Poll > m_poll_thread;
+        Stream m_stream;
+        ScopedThread< Stream > m_stream_thread;
+        std::vector< std::unique_ptr< Loop > > m_loops;
+        std::vector< std::unique_ptr< ScopedThread< Loop > > > m_loop_threads;
+        std::unique_ptr< http::Server > m_http;
+        std::unique_ptr< ScopedThread< http::Server > > m_http_thread;
     };
 
 }  // namespace rtsp
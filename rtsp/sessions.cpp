@@ -0,0 +1,52 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#include "sessions.h"
+#include "connection.h"
+#include <algorithm>
+
+rtsp::Sessions::Id rtsp::Sessions::insert( int fd, const std::shared_ptr< Connection > &conn )
+{
+    if( size_t(fd) >= m_slots.size() )
+    {
+        m_slots.resize( std::max( size_t(fd) + 1, m_slots.size() * 2 ) );
+    }
+    Slot &slot = m_slots[fd];
+    if( slot.conn )
+    {
+        erase( fd );
+    }
+    slot.conn = conn;
+    ++slot.generation;
+    slot.position = m_live.size();
+    for( auto &t : slot.timers )
+    {
+        t = 0;
+    }
+    m_live.push_back( fd );
+    return id( fd );
+}
+
+void rtsp::Sessions::erase( int fd )
+{
+    Slot *slot = find( fd );
+    if( !slot )
+    {
+        return;
+    }
+    int last = m_live.back();
+    m_live[slot->position] = last;
+    m_slots[last].position = slot->position;
+    m_live.pop_back();
+    slot->conn.reset();
+}
+
+void rtsp::Sessions::clear()
+{
+    for( int fd : m_live )
+    {
+        m_slots[fd].conn.reset();
+    }
+    m_live.clear();
+}
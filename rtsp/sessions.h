@@ -0,0 +1,77 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#ifndef RTSP_SESSIONS_H
+#define RTSP_SESSIONS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace rtsp {
+
+    class Connection;
+
+    // Connections of a loop in a slab indexed by the socket descriptor. The kernel hands out
+    // the lowest free descriptors, so the slab stays dense: lookup, insertion and removal are
+    // O(1), and the live connections are packed into an array for the per-frame fan-out.
+    // The generation of a slot changes with every connection in it, so a timer that keeps
+    // the Id never hits a newer connection that got the same descriptor
+    class Sessions {
+    public:
+        using Id = uint64_t;    // generation << 32 | fd
+
+        enum Timer { Deadline, Report, TIMERS };
+
+        struct Slot
+        {
+            std::shared_ptr< Connection > conn;
+            uint32_t generation {0};
+            uint32_t position {0};          // in the packed array
+            uint64_t timers[TIMERS] {};     // TimerWheel ids, 0 - none
+        };
+
+        Id insert( int fd, const std::shared_ptr< Connection > &conn );
+        // the connection is destroyed with the last reference to it
+        void erase( int fd );
+        void clear();
+
+        // nullptr if there is no such connection
+        Slot *find( int fd )
+        {
+            return fd >= 0 && size_t(fd) < m_slots.size() && m_slots[fd].conn ? &m_slots[fd] : nullptr;
+        }
+        Slot *find_id( Id id )
+        {
+            Slot *slot = find( fd( id ) );
+            return slot && slot->generation == uint32_t(id >> 32) ? slot : nullptr;
+        }
+        Id id( int fd ) const
+        {
+            return (uint64_t(m_slots[fd].generation) << 32) | uint32_t(fd);
+        }
+        static int fd( Id id )
+        {
+            return int(uint32_t(id));
+        }
+
+        // packed array of the live connections, removal moves the last one into the gap
+        size_t size() const
+        {
+            return m_live.size();
+        }
+        Connection &operator []( size_t i ) const
+        {
+            return *m_slots[m_live[i]].conn;
+        }
+
+    private:
+        std::vector< Slot > m_slots;
+        std::vector< int > m_live;
+    };
+
+}  // namespace rtsp
+
+#endif /* RTSP_SESSIONS_H */
@@ -6,17 +6,24 @@
  */
 
 #include "socket.h"
+#include "rtp.h"
 #include <unistd.h>
 #include <fcntl.h>
+#include <netinet/udp.h>
+#include <cerrno>
 #include <cstring>
 #include <iostream>
 
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
 rtsp::SocketError::SocketError( const std::string &what )
 : std::runtime_error( what + std::string(" failed: ") + std::string(strerror( errno )) )
 {}
 
 
-rtsp::Socket::Socket( uint16_t b_port )
+rtsp::Socket::Socket( uint16_t b_port, bool reuseport )
 {
     sockaddr_in b_addr;
     memset( &b_addr, 0, sizeof(struct sockaddr_in) );
@@ -30,6 +37,12 @@ rtsp::Socket::Socket( uint16_t b_port )
     
     long yes { 0 };
     setsockopt( m_fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof (int) );
+    int one { 1 };
+    if( reuseport && setsockopt( m_fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one) ) == -1 )
+    {
+        close( m_fd );
+        throw SocketError( "SO_REUSEPORT" );
+    }
 
     if( bind( m_fd, (struct sockaddr *)&b_addr, sizeof(b_addr)) == -1 )
     {
@@ -50,3 +63,143 @@ rtsp::Socket::~Socket()
     close( m_fd );
     std::cerr << "[*] stop listening\n";
 }
+
+
+rtsp::UdpSocket::UdpSocket( uint16_t b_port, bool reuseport )
+: m_port( b_port )
+{
+    sockaddr_in b_addr;
+    memset( &b_addr, 0, sizeof(struct sockaddr_in) );
+    b_addr.sin_family = AF_INET;
+    b_addr.sin_addr.s_addr = INADDR_ANY;
+    b_addr.sin_port = htons(b_port);
+    if( (m_fd = socket( b_addr.sin_family, SOCK_DGRAM, 0 )) == -1)
+    {
+        throw SocketError( "socket" );
+    }
+    int one { 1 };
+    if( reuseport && setsockopt( m_fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one) ) == -1 )
+    {
+        close( m_fd );
+        throw SocketError( "SO_REUSEPORT" );
+    }
+    if( bind( m_fd, (struct sockaddr *)&b_addr, sizeof(b_addr)) == -1 )
+    {
+        close( m_fd );
+        throw SocketError( "bind" );
+    }
+    int sndbuf = 4 * 1024 * 1024;
+    setsockopt( m_fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf) );
+    fcntl( m_fd, F_SETFL, fcntl(m_fd, F_GETFL, 0) | O_NONBLOCK );
+
+    m_iov.resize( MAX_BATCH * MAX_SEGMENTS * 2 );
+    m_msgs.resize( MAX_BATCH );
+    m_segments.resize( MAX_BATCH );
+    m_control.resize( MAX_BATCH * CMSG_SPACE(sizeof(uint16_t)) );
+    if( b_port )
+    {
+        std::cerr << "[*] udp on port " << b_port << "\n";
+    }
+}
+
+rtsp::UdpSocket::~UdpSocket()
+{
+    close( m_fd );
+}
+
+size_t rtsp::UdpSocket::send( const sockaddr_in &addr, const rtp::Frame &frame, const uint8_t *headers )
+{
+    const size_t hs = rtp::Session::HEADER_SIZE;
+    const size_t skip = rtp::Interleaved::SIZE;
+    const size_t count = frame.packets.size();
+    const size_t cs = CMSG_SPACE(sizeof(uint16_t));
+
+    auto length = [&frame, skip]( size_t i ){
+        return frame.packet_size( i ) - skip;
+    };
+
+    size_t sent = 0;
+    while( sent < count )
+    {
+        size_t n = 0;
+        size_t iov = 0;
+        for( size_t i = sent; i < count && n < MAX_BATCH; ++n )
+        {
+            // all segments of a GSO datagram have the same size, only the last one may be shorter
+            size_t seg = length( i );
+            size_t total = 0;
+            size_t first_iov = iov;
+            size_t segments = 0;
+            do
+            {
+                m_iov[iov].iov_base = (void *)(headers + i * hs + skip);
+                m_iov[iov++].iov_len = hs - skip;
+                m_iov[iov].iov_base = (void *)(frame.data.data() + frame.packets[i] + hs);
+                m_iov[iov++].iov_len = length( i ) - (hs - skip);
+                total += length( i );
+                ++segments;
+                ++i;
+            }
+            while( m_gso && i < count && segments < MAX_SEGMENTS && total + length( i ) <= MAX_GSO_SIZE &&
+                   length( i - 1 ) == seg && length( i ) <= seg );
+
+            mmsghdr &m = m_msgs[n];
+            memset( &m, 0, sizeof(m) );
+            m.msg_hdr.msg_name = (void *)&addr;
+            m.msg_hdr.msg_namelen = sizeof(addr);
+            m.msg_hdr.msg_iov = &m_iov[first_iov];
+            m.msg_hdr.msg_iovlen = iov - first_iov;
+            if( segments > 1 )
+            {
+                m.msg_hdr.msg_control = &m_control[n * cs];
+                m.msg_hdr.msg_controllen = cs;
+                cmsghdr *cm = CMSG_FIRSTHDR( &m.msg_hdr );
+                cm->cmsg_level = SOL_UDP;
+                cm->cmsg_type = UDP_SEGMENT;
+                cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                uint16_t gso_size = seg;
+                memcpy( CMSG_DATA(cm), &gso_size, sizeof(gso_size) );
+            }
+            m_segments[n] = segments;
+        }
+
+        int rc = sendmmsg( m_fd, m_msgs.data(), n, 0 );
+        if( rc <= 0 )
+        {
+            if( rc < 0 && m_gso && (errno == EIO || errno == EINVAL || errno == ENOPROTOOPT) )
+            {
+                // no GSO support for the route - one datagram per packet from now on
+                std::cerr << "[*] udp gso is not available: " << strerror( errno ) << "\n";
+                m_gso = false;
+                continue;
+            }
+            break;
+        }
+        for( int k = 0; k < rc; ++k )
+        {
+            sent += m_segments[k];
+        }
+        if( size_t(rc) < n )
+        {
+            break;
+        }
+    }
+    return sent;
+}
+
+bool rtsp::UdpSocket::send( const sockaddr_in &addr, const uint8_t *data, size_t size )
+{
+    return ::sendto( m_fd, data, size, 0, (const sockaddr *)&addr, sizeof(addr) ) == ssize_t(size);
+}
+
+ssize_t rtsp::UdpSocket::receive( sockaddr_in &addr, uint8_t *data, size_t size )
+{
+    socklen_t len = sizeof(addr);
+    ssize_t rc;
+    do
+    {
+        rc = ::recvfrom( m_fd, data, size, 0, (sockaddr *)&addr, &len );
+    }
+    while( rc < 0 && errno == EINTR );
+    return rc;
+}
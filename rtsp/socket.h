@@ -12,8 +12,14 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <sys/uio.h>
 
 #include <stdexcept>
+#include <vector>
+
+namespace rtp {
+    struct Frame;
+}
 
 namespace rtsp {
 
@@ -25,7 +31,8 @@ namespace rtsp {
 
     class Socket {
     public:
-        explicit Socket( uint16_t b_port );
+        // reuseport - several listeners on the same port, one per event loop
+        explicit Socket( uint16_t b_port, bool reuseport = false );
         Socket(const Socket& orig) = delete;
         Socket &operator =(const Socket& orig) = delete;
         ~Socket();
@@ -39,6 +46,46 @@ private:
 
 };
 
+    // RTP over UDP. The packets of a frame go out with sendmmsg, runs of equally sized
+    // packets (FU-A fragments) are coalesced into one UDP GSO datagram each
+    class UdpSocket {
+    public:
+        static const size_t MAX_BATCH = 64;         // messages per sendmmsg
+        static const size_t MAX_SEGMENTS = 64;      // UDP_MAX_SEGMENTS
+        static const size_t MAX_GSO_SIZE = 65000;
+
+        explicit UdpSocket( uint16_t b_port, bool reuseport = false );
+        UdpSocket(const UdpSocket& orig) = delete;
+        UdpSocket &operator =(const UdpSocket& orig) = delete;
+        ~UdpSocket();
+
+        operator int() const {
+            return m_fd;
+        }
+        uint16_t port() const {
+            return m_port;
+        }
+
+        // headers - rtp::Session::HEADER_SIZE bytes per packet, the interleaved part is skipped.
+        // Returns the number of packets sent
+        size_t send( const sockaddr_in &addr, const rtp::Frame &frame, const uint8_t *headers );
+
+        // a single datagram (RTCP), false if it could not be sent
+        bool send( const sockaddr_in &addr, const uint8_t *data, size_t size );
+        // -1 when there is nothing to read
+        ssize_t receive( sockaddr_in &addr, uint8_t *data, size_t size );
+
+    private:
+        int m_fd;
+        uint16_t m_port;
+        bool m_gso {true};
+
+        std::vector< iovec > m_iov;
+        std::vector< mmsghdr > m_msgs;
+        std::vector< size_t > m_segments;
+        std::vector< char > m_control;
+    };
+
 
 }  //namespace rtsp
 
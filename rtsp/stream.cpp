@@ -0,0 +1,418 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#include "stream.h"
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <ifaddrs.h>
+
+namespace {
+
+    const std::string base64_chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                                     "abcdefghijklmnopqrstuvwxyz"
+                                     "0123456789+/";
+
+    std::string base64_encode( unsigned char const* bytes_to_encode, unsigned int in_len )
+    {
+        std::string ret;
+        int i = 0;
+        int j = 0;
+        unsigned char char_array_3[3];
+        unsigned char char_array_4[4];
+
+        while (in_len--)
+        {
+            char_array_3[i++] = *(bytes_to_encode++);
+            if (i == 3) {
+                char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
+                char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
+                char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
+                char_array_4[3] = char_array_3[2] & 0x3f;
+
+                for(i = 0; (i <4) ; i++)
+                    ret += base64_chars[char_array_4[i]];
+                i = 0;
+            }
+        }
+
+        if (i)
+        {
+            for(j = i; j < 3; j++)
+                char_array_3[j] = '\0';
+
+            char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
+            char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
+            char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
+            char_array_4[3] = char_array_3[2] & 0x3f;
+
+            for (j = 0; (j < i + 1); j++)
+                ret += base64_chars[char_array_4[j]];
+
+            while((i++ < 3))
+                ret += '=';
+        }
+
+        return ret;
+    }
+
+    std::string IP()
+    {
+        std::string rc;
+        ifaddrs * if_addr = nullptr;
+        if( getifaddrs( &if_addr ) == 0 && if_addr != nullptr )
+        {
+            ifaddrs * ifa = nullptr;
+            for( ifa = if_addr; ifa; ifa = ifa->ifa_next )
+            {
+                if( !ifa->ifa_addr )
+                {
+                    continue;
+                }
+                if( ifa->ifa_addr->sa_family == AF_INET ) {
+                    in_addr_t s_addr = ((sockaddr_in*)ifa->ifa_addr)->sin_addr.s_addr;
+                    if( s_addr == 0x0100007f )
+                    {
+                        continue;
+                    }
+                    void *ptr = &((sockaddr_in*)ifa->ifa_addr)->sin_addr;
+                    char buf[ INET_ADDRSTRLEN ];
+                    inet_ntop( AF_INET, ptr, buf, INET_ADDRSTRLEN );
+                    rc.assign( buf );
+                    break;
+                }
+            }
+            freeifaddrs( if_addr );
+        }
+        return rc;
+    }
+
+}  // namespace
+
+
+rtsp::Stream::Stream( const Options &options, int fps, size_t loops, Governor *governor )
+: m_options( options )
+, m_fps( fps )
+, m_governor( governor )
+, m_host( IP() )
+, m_lossless( !options.record.empty() )
+, m_wake( eventfd( 0, EFD_CLOEXEC ) )
+, m_multicast_sessions( new std::atomic< int >[loops] )
+, m_loops( loops )
+{
+    if( m_wake == -1 )
+    {
+        throw std::runtime_error( std::string("[stream] eventfd failed: ") + strerror( errno ) );
+    }
+    for( size_t i = 0; i < m_loops; ++i )
+    {
+        m_multicast_sessions[i].store( 0 );
+
+        int fd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+        if( fd == -1 )
+        {
+            for( int w : m_wakeups )
+            {
+                close( w );
+            }
+            close( m_wake );
+            throw std::runtime_error( std::string("[stream] eventfd failed: ") + strerror( errno ) );
+        }
+        m_wakeups.push_back( fd );
+    }
+    // udp sessions and multicast need their own, MTU-sized, packets
+    bool datagrams = m_options.rtp_port || !m_options.multicast.empty();
+    if( m_options.codec == Codec::JPEG )
+    {
+        m_rtp.reset( new rtp::JPEG( rtp::Packetizer::STREAM_PAYLOAD_SIZE ) );
+        if( datagrams )
+        {
+            m_rtp_datagram.reset( new rtp::JPEG( rtp::Packetizer::DATAGRAM_PAYLOAD_SIZE ) );
+        }
+    }
+    else
+    {
+        m_rtp.reset( new rtp::RTP( rtp::Packetizer::STREAM_PAYLOAD_SIZE ) );
+        if( datagrams )
+        {
+            m_rtp_datagram.reset( new rtp::RTP( rtp::Packetizer::DATAGRAM_PAYLOAD_SIZE ) );
+        }
+    }
+    if( !m_options.multicast.empty() )
+    {
+        m_multicast.reset( new Multicast( m_options ) );
+    }
+    if( !m_options.record.empty() )
+    {
+        m_recorder.reset( new Recorder( m_options.record, m_options.codec, m_options.record_formats, m_options.record_size, m_options.record_duration ) );
+    }
+    if( m_options.http_port )
+    {
+        if( m_options.codec == Codec::JPEG )
+        {
+            std::cerr << "[http] fmp4 and hls are available for h264 only\n";
+        }
+        else
+        {
+            m_segmenter.reset( new http::Segmenter );
+        }
+    }
+}
+
+rtsp::Stream::~Stream()
+{
+    if( m_latest.overwritten() || m_queue.dropped() )
+    {
+        std::cerr << "[*] stream: " << m_latest.overwritten() << " frames replaced before encoding, "
+                  << m_queue.dropped() << " dropped by the full recording queue\n";
+    }
+    for( int fd : m_wakeups )
+    {
+        close( fd );
+    }
+    close( m_wake );
+}
+
+void rtsp::Stream::run()
+{
+    while( m_running.load() )
+    {
+        uint64_t count;
+        if( ::read( m_wake, &count, sizeof(count) ) != sizeof(count) && errno != EINTR )
+        {
+            std::cerr << "[-] stream: eventfd read failed: " << strerror( errno ) << std::endl;
+            break;
+        }
+
+        if( m_lossless )
+        {
+            while( Frame *f = m_queue.front() )
+            {
+                // the slot goes back to the window thread right away, the frame is ours
+                cv::Mat fr = std::move( f->image );
+                int delay = f->delay;
+                m_queue.pop();
+                f_encode( fr, delay );
+            }
+        }
+        else if( Frame *f = m_latest.acquire() )
+        {
+            cv::Mat fr = std::move( f->image );
+            if( !fr.empty() )
+            {
+                f_encode( fr, f->delay );
+            }
+        }
+    }
+}
+
+void rtsp::Stream::stop()
+{
+    m_running.store( false );
+    uint64_t one = 1;
+    (void)!::write( m_wake, &one, sizeof(one) );
+}
+
+void rtsp::Stream::store( cv::Mat &frame, int delay )
+{
+    if( m_lossless )
+    {
+        Frame *f = m_queue.back();
+        if( !f )
+        {
+            // the encoder is behind by the whole queue
+            return;
+        }
+        f->image = std::move( frame );
+        f->delay = delay;
+        m_queue.publish();
+    }
+    else
+    {
+        Frame &f = m_latest.back();
+        f.image = std::move( frame );
+        f.delay = delay;
+        m_latest.publish();
+    }
+    uint64_t one = 1;
+    (void)!::write( m_wake, &one, sizeof(one) );
+}
+
+std::string rtsp::Stream::sdp()
+{
+    std::lock_guard< std::mutex > lk( m_mutex );
+    return m_sdp;
+}
+
+std::vector< rtp::Packetized > rtsp::Stream::gop( uint64_t seq )
+{
+    std::lock_guard< std::mutex > lk( m_mutex );
+    const auto &units = m_gop.units();
+    // the cache ends with the last published unit, m_seq
+    size_t newer = m_seq > seq ? m_seq - seq : 0;
+    if( newer >= units.size() )
+    {
+        return {};
+    }
+    return std::vector< rtp::Packetized >( units.begin(), units.end() - newer );
+}
+
+bool rtsp::Stream::fetch( uint64_t &seq, std::vector< Unit > &units )
+{
+    std::lock_guard< std::mutex > lk( m_mutex );
+    if( m_published.empty() || m_published.back().seq <= seq )
+    {
+        return true;
+    }
+    bool complete = m_published.front().seq <= seq + 1;
+    size_t first = complete ? seq + 1 - m_published.front().seq : 0;
+    units.insert( units.end(), m_published.begin() + first, m_published.end() );
+    seq = m_published.back().seq;
+    return complete;
+}
+
+void rtsp::Stream::f_encode( cv::Mat &fr, int delay )
+{
+    Encoder::PS sps, pps;
+
+    auto t0 = std::chrono::steady_clock::now();
+    if( !m_encoder || m_encoder_size != fr.size() )
+    {
+        // the frame size changes when the governor scales the output
+        m_encoder.reset( new Encoder( m_options, fr.cols, fr.rows, m_fps ) );
+        m_encoder_size = fr.size();
+    }
+    if( m_governor )
+    {
+        m_encoder->set_speed( m_governor->encoder_speed() );
+    }
+    // every client loss and PLI asks for one: an IDR each frame would flood the lossy path
+    if( m_keyframe_requested.load() && t0 - m_keyframe >= MIN_KEYFRAME_INTERVAL )
+    {
+        m_keyframe_requested.store( false );
+        m_keyframe = t0;
+        m_encoder->request_keyframe();
+    }
+    m_encoder->encode( fr, delay, &sps, &pps );
+    auto t1 = std::chrono::steady_clock::now();
+    if( m_encoder->size() && m_encoder->keyframe() )
+    {
+        m_keyframe = t0;
+        m_keyframe_requested.store( false );
+    }
+    if( m_governor )
+    {
+        m_governor->report( Governor::Encode, t1 - t0 );
+    }
+    if( !m_encoder->size() )
+    {
+        return;
+    }
+
+    std::string description;
+    if( m_options.codec == Codec::JPEG )
+    {
+        if( sdp().empty() )
+        {
+            description = std::string("v=0\r\n") +
+                          std::string("o=- 0 0 IN IP4 ") + m_host + "\r\n" +
+                          std::string("s=No Title\r\n") +
+                          std::string("c=IN IP4 0.0.0.0\r\n") +
+                          std::string("t=0 0\r\n") +
+                          std::string("m=video 0 RTP/AVP 26\r\n") +
+                          std::string("a=rtpmap:26 JPEG/90000\r\n") +
+                          std::string("a=control:1\r\n");
+        }
+    }
+    else if( !sps.empty() && !pps.empty() )
+    {
+        char buf[32];
+        sprintf( buf, "%02x%02x%02x", sps[1], sps[2], sps[3] );
+
+        description = std::string("v=0\r\n") +
+                      std::string("o=- 0 0 IN IP4 ") + m_host + "\r\n" +
+                      std::string("s=No Title\r\n") +
+                      std::string("c=IN IP4 0.0.0.0\r\n") +
+                      std::string("t=0 0\r\n") +
+                      std::string("m=video 0 RTP/AVP 96\r\n") +
+                      std::string("a=rtpmap:96 H264/90000\r\n") +
+                      std::string("a=control:1\r\n") +
+                      std::string("a=fmtp:96 packetization-mode=1;sprop-parameter-sets=") +
+                      base64_encode( sps.data(), sps.size() ) + "," + base64_encode( pps.data(), pps.size() ) + ";" +
+                      std::string("profile-level-id=") + buf;
+    }
+
+    if( !description.empty() )
+    {
+        std::lock_guard< std::mutex > lk( m_mutex );
+        m_sdp = description;
+    }
+
+    if( m_recorder )
+    {
+        m_recorder->store( sps, pps, m_encoder->data(), m_encoder->size(), m_encoder->keyframe(), delay, fr.cols, fr.rows );
+    }
+    if( m_segmenter )
+    {
+        m_segmenter->store( sps, pps, m_encoder->data(), m_encoder->size(), m_encoder->keyframe(), delay, fr.cols, fr.rows );
+    }
+
+    // packetized once per transport, every session only patches its own headers
+    rtp::Packetized frame;
+    frame.stream = m_rtp->packetize( m_encoder->data(), m_encoder->size(), delay, m_encoder->keyframe(), sps, pps );
+    if( m_rtp_datagram )
+    {
+        frame.datagram = m_rtp_datagram->packetize( m_encoder->data(), m_encoder->size(), delay, m_encoder->keyframe(), sps, pps );
+    }
+    f_publish( frame );
+
+    if( m_multicast )
+    {
+        int sessions = 0;
+        for( size_t i = 0; i < m_loops; ++i )
+        {
+            sessions += m_multicast_sessions[i].load();
+        }
+        if( sessions )
+        {
+            m_multicast->send( frame.datagram );
+        }
+        else
+        {
+            m_multicast->reset();
+        }
+    }
+    if( m_governor )
+    {
+        m_governor->report( Governor::Send, std::chrono::steady_clock::now() - t1 );
+    }
+}
+
+void rtsp::Stream::f_publish( const rtp::Packetized &frame )
+{
+    {
+        std::lock_guard< std::mutex > lk( m_mutex );
+        m_gop.store( frame );
+        m_published.push_back( Unit{ ++m_seq, frame } );
+        if( m_published.size() > MAX_PUBLISHED )
+        {
+            m_published.pop_front();
+        }
+    }
+    for( size_t i = 0; i < m_loops; ++i )
+    {
+        notify( i );
+    }
+}
+
+void rtsp::Stream::notify( size_t loop )
+{
+    uint64_t one = 1;
+    // EAGAIN: the counter is full, the loop is going to wake up anyway
+    (void)!::write( m_wakeups[loop], &one, sizeof(one) );
+}
@@ -0,0 +1,131 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#ifndef RTSP_STREAM_H
+#define RTSP_STREAM_H
+
+#include "gop.h"
+#include "mailbox.h"
+#include "multicast.h"
+#include "rtp.h"
+#include "../http/segmenter.h"
+#include "../encoder.h"
+#include "../governor.h"
+#include "../options.h"
+#include "../recorder.h"
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace rtsp {
+
+    // Encodes the frames on its own thread and publishes every access unit, packetized once,
+    // to all event loops. The loops only read the published frames
+    class Stream {
+    public:
+        static const size_t MAX_PUBLISHED = 256;
+        // frames queued for the encoder while recording, when none of them may be skipped
+        static const size_t RECORD_QUEUE = 8;
+        // between the keyframes requested by the clients
+        static constexpr std::chrono::seconds MIN_KEYFRAME_INTERVAL {1};
+
+        // access unit as published to the loops, keyframes carry their parameter sets in-band
+        struct Unit
+        {
+            uint64_t seq;
+            rtp::Packetized frame;
+        };
+
+        Stream( const Options &options, int fps, size_t loops, Governor *governor = nullptr );
+        Stream(const Stream& orig) = delete;
+        Stream &operator =(const Stream& orig) = delete;
+        ~Stream();
+
+        void run();
+        void stop();
+
+        void store( cv::Mat &frame, int delay );
+
+        // thread-safe, called by the loops
+        std::string sdp();
+        // the cached group of frames up to the unit seq, the last one the loop has fetched: the
+        // newer ones reach the joining session with the next fetch, not twice
+        std::vector< rtp::Packetized > gop( uint64_t seq );
+        // appends the units published after seq, returns false if some of them are already gone
+        bool fetch( uint64_t &seq, std::vector< Unit > &units );
+        // honoured at most once per MIN_KEYFRAME_INTERVAL, a keyframe of the encoder's own resets it
+        void request_keyframe()
+        {
+            m_keyframe_requested.store( true );
+        }
+        const Multicast *multicast() const
+        {
+            return m_multicast.get();
+        }
+        // fMP4 / LL-HLS of the stream for the HTTP server, nullptr if there is no HTTP egress
+        http::Segmenter *segmenter() const
+        {
+            return m_segmenter.get();
+        }
+        void multicast_sessions( size_t loop, int count )
+        {
+            m_multicast_sessions[loop].store( count );
+        }
+        // eventfd the loop waits on in its epoll set, signalled on every published unit
+        int wakeup( size_t loop ) const
+        {
+            return m_wakeups[loop];
+        }
+        void notify( size_t loop );
+
+    private:
+        Options m_options;
+        int m_fps;
+        Governor *m_governor;
+        std::string m_host;
+
+        struct Frame
+        {
+            cv::Mat image;
+            int delay {-1};
+        };
+        // the window thread hands the frames over without locks: the latest one for the live
+        // stream, every one of them (while the queue lasts) for the recording
+        bool m_lossless;
+        TripleBuffer< Frame > m_latest;
+        SpscRing< Frame, RECORD_QUEUE > m_queue;
+        int m_wake;         // blocking eventfd the stream thread sleeps on
+        std::atomic< bool > m_running { true };
+
+        std::unique_ptr< Encoder > m_encoder;
+        cv::Size m_encoder_size;
+        std::atomic< bool > m_keyframe_requested { false };
+        std::chrono::steady_clock::time_point m_keyframe;   // the last one encoded
+        std::unique_ptr< rtp::Packetizer > m_rtp;           // RTSP over TCP
+        std::unique_ptr< rtp::Packetizer > m_rtp_datagram;  // RTP over UDP and multicast, MTU-sized packets
+        std::unique_ptr< Recorder > m_recorder;
+        std::unique_ptr< http::Segmenter > m_segmenter;
+        std::unique_ptr< Multicast > m_multicast;
+        std::unique_ptr< std::atomic< int >[] > m_multicast_sessions;
+        std::vector< int > m_wakeups;
+        size_t m_loops;
+
+        std::mutex m_mutex;     // guards everything below
+        std::string m_sdp;
+        GopCache m_gop;
+        std::deque< Unit > m_published;
+        uint64_t m_seq {0};
+
+    private:
+        void f_encode( cv::Mat &fr, int delay );
+        void f_publish( const rtp::Packetized &frame );
+    };
+
+}  // namespace rtsp
+
+#endif /* RTSP_STREAM_H */
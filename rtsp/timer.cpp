@@ -0,0 +1,195 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#include "timer.h"
+#include <algorithm>
+
+rtsp::TimerWheel::TimerWheel( Clock::time_point now )
+: m_start( now )
+, m_slots( SLOTS, NONE )
+{}
+
+uint64_t rtsp::TimerWheel::schedule( Clock::time_point when, Callback callback )
+{
+    uint32_t index;
+    if( m_free.empty() )
+    {
+        index = m_nodes.size();
+        m_nodes.emplace_back();
+    }
+    else
+    {
+        index = m_free.back();
+        m_free.pop_back();
+    }
+
+    // округление вверх: таймер не срабатывает раньше времени
+    uint64_t tick = m_tick;
+    if( when > m_start )
+    {
+        auto ticks = (when - m_start + RESOLUTION - Clock::duration( 1 )) / RESOLUTION;
+        tick = std::max( tick, uint64_t(ticks) );
+    }
+
+    Node &node = m_nodes[index];
+    node.tick = tick;
+    node.callback = std::move( callback );
+    node.active = true;
+
+    size_t slot = tick % SLOTS;
+    uint32_t &head = m_slots[slot];
+    m_occupied[slot / 64] |= uint64_t(1) << (slot % 64);
+    node.prev = NONE;
+    node.next = head;
+    if( head != NONE )
+    {
+        m_nodes[head].prev = index;
+    }
+    head = index;
+    ++m_size;
+    if( m_next_valid && tick < m_next )
+    {
+        m_next = tick;
+    }
+
+    return (uint64_t(node.generation) << 32) | index;
+}
+
+void rtsp::TimerWheel::cancel( uint64_t id )
+{
+    uint32_t index = uint32_t(id);
+    if( index < m_nodes.size() && m_nodes[index].active && m_nodes[index].generation == uint32_t(id >> 32) )
+    {
+        if( m_nodes[index].tick == m_next )
+        {
+            m_next_valid = false;
+        }
+        f_unlink( index );
+    }
+}
+
+void rtsp::TimerWheel::advance( Clock::time_point now )
+{
+    if( now < m_start )
+    {
+        return;
+    }
+    uint64_t target = uint64_t((now - m_start) / RESOLUTION);
+    if( target < m_tick )
+    {
+        return;
+    }
+
+    // за один оборот колеса просматривается каждый слот
+    m_due.clear();
+    uint64_t slots = std::min< uint64_t >( target - m_tick + 1, SLOTS );
+    for( uint64_t i = 0; i < slots; ++i )
+    {
+        for( uint32_t index = m_slots[(m_tick + i) % SLOTS]; index != NONE; index = m_nodes[index].next )
+        {
+            if( m_nodes[index].tick <= target )
+            {
+                m_due.push_back( (uint64_t(m_nodes[index].generation) << 32) | index );
+            }
+        }
+    }
+    m_tick = target + 1;
+    if( target >= m_next )
+    {
+        m_next_valid = false;
+    }
+
+    // callbacks may cancel the timers that are not fired yet
+    std::vector< uint64_t > due;
+    due.swap( m_due );
+    for( uint64_t id : due )
+    {
+        uint32_t index = uint32_t(id);
+        Node &node = m_nodes[index];
+        if( !node.active || node.generation != uint32_t(id >> 32) )
+        {
+            continue;
+        }
+        Callback callback = std::move( node.callback );
+        f_unlink( index );
+        callback();
+    }
+    due.clear();
+    m_due.swap( due );
+}
+
+rtsp::TimerWheel::Clock::time_point rtsp::TimerWheel::next() const
+{
+    if( !m_size )
+    {
+        return Clock::time_point::max();
+    }
+    if( !m_next_valid )
+    {
+        m_next = f_next();
+        m_next_valid = true;
+    }
+    return m_start + m_next * RESOLUTION;
+}
+
+uint64_t rtsp::TimerWheel::f_next() const
+{
+    uint64_t end = m_tick + SLOTS;
+    for( uint64_t tick = m_tick; tick < end; ++tick )
+    {
+        // пустые слоты пропускаются по битовой карте
+        size_t slot = tick % SLOTS;
+        uint64_t word = m_occupied[slot / 64] >> (slot % 64);
+        if( !word )
+        {
+            tick += 63 - slot % 64;
+            continue;
+        }
+        tick += __builtin_ctzll( word );
+        if( tick >= end )
+        {
+            break;
+        }
+        for( uint32_t index = m_slots[tick % SLOTS]; index != NONE; index = m_nodes[index].next )
+        {
+            if( m_nodes[index].tick <= tick )
+            {
+                return tick;
+            }
+        }
+    }
+    // only timers beyond this turn of the wheel: look again after it
+    return end;
+}
+
+void rtsp::TimerWheel::f_unlink( uint32_t index )
+{
+    Node &node = m_nodes[index];
+    if( node.prev != NONE )
+    {
+        m_nodes[node.prev].next = node.next;
+    }
+    else
+    {
+        size_t slot = node.tick % SLOTS;
+        m_slots[slot] = node.next;
+        if( node.next == NONE )
+        {
+            m_occupied[slot / 64] &= ~(uint64_t(1) << (slot % 64));
+        }
+    }
+    if( node.next != NONE )
+    {
+        m_nodes[node.next].prev = node.prev;
+    }
+    node.active = false;
+    node.callback = nullptr;
+    ++node.generation;
+    if( !node.generation )
+    {
+        node.generation = 1;
+    }
+    m_free.push_back( index );
+    --m_size;
+}
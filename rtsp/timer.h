@@ -0,0 +1,80 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#ifndef RTSP_TIMER_H
+#define RTSP_TIMER_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace rtsp {
+
+    // Hashed timer wheel of the event loop: scheduling, cancelling and firing a timer are O(1).
+    // A timer further away than one turn of the wheel stays in its slot until its own tick comes.
+    // Timers never fire early, at most one RESOLUTION late
+    class TimerWheel {
+    public:
+        using Clock = std::chrono::steady_clock;
+        using Callback = std::function< void() >;
+
+        static constexpr std::chrono::milliseconds RESOLUTION {1};
+        static constexpr size_t SLOTS = 512;
+        static_assert( SLOTS % 64 == 0, "the occupied slots are a bitmap of 64-bit words" );
+
+        explicit TimerWheel( Clock::time_point now = Clock::now() );
+        TimerWheel(const TimerWheel& orig) = delete;
+        TimerWheel &operator =(const TimerWheel& orig) = delete;
+
+        // returns the timer id, never 0
+        uint64_t schedule( Clock::time_point when, Callback callback );
+        // unknown or already fired ids are ignored
+        void cancel( uint64_t id );
+        // fires every timer due by now, the callbacks may schedule and cancel timers
+        void advance( Clock::time_point now );
+        // the moment advance() has to be called next, Clock::time_point::max() - no timers.
+        // Cached: the slots are looked through again only after the earliest timer has fired
+        // or has been cancelled, and then only the occupied ones
+        Clock::time_point next() const;
+
+        size_t size() const
+        {
+            return m_size;
+        }
+
+    private:
+        static constexpr uint32_t NONE = UINT32_MAX;
+
+        struct Node
+        {
+            uint64_t tick {0};
+            Callback callback;
+            uint32_t generation {1};
+            uint32_t prev {NONE};
+            uint32_t next {NONE};
+            bool active {false};
+        };
+
+        Clock::time_point m_start;
+        uint64_t m_tick {0};            // the next tick to process
+        std::vector< Node > m_nodes;
+        std::vector< uint32_t > m_free;
+        std::vector< uint32_t > m_slots;
+        std::vector< uint64_t > m_due;
+        size_t m_size {0};
+        std::array< uint64_t, SLOTS / 64 > m_occupied {};   // a bit per non-empty slot
+        mutable uint64_t m_next {0};    // the tick next() returns
+        mutable bool m_next_valid {false};
+
+    private:
+        void f_unlink( uint32_t index );
+        uint64_t f_next() const;
+    };
+
+}  // namespace rtsp
+
+#endif /* RTSP_TIMER_H */
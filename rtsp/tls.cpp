@@ -0,0 +1,184 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#include "tls.h"
+#include <openssl/err.h>
+#include <cerrno>
+#include <cstring>
+
+namespace {
+
+    std::string ssl_error()
+    {
+        unsigned long err = ERR_get_error();
+        ERR_clear_error();
+        if( !err )
+        {
+            return strerror( errno );
+        }
+        char buf[256];
+        ERR_error_string_n( err, buf, sizeof(buf) );
+        return buf;
+    }
+
+    // AES-GCM and ChaCha20-Poly1305: what the kernel TLS implementation can encrypt
+    const char *CIPHERS = "ECDHE+AESGCM:ECDHE+CHACHA20";
+    const char *CIPHERSUITES = "TLS_AES_128_GCM_SHA256:TLS_AES_256_GCM_SHA384:TLS_CHACHA20_POLY1305_SHA256";
+
+    const size_t READ_SIZE = 16384;     // the largest TLS record
+
+}  // namespace
+
+
+rtsp::TlsError::TlsError( const std::string &what )
+: std::runtime_error( "[tls] " + what + " failed: " + ssl_error() )
+{}
+
+
+rtsp::TlsContext::TlsContext( const std::string &cert, const std::string &key )
+: m_ctx( SSL_CTX_new( TLS_server_method() ) )
+{
+    if( !m_ctx )
+    {
+        throw TlsError( "SSL_CTX_new" );
+    }
+    SSL_CTX_set_min_proto_version( m_ctx, TLS1_2_VERSION );
+    // no renegotiation (the kernel can not rekey), no compression, keys go to the kernel
+    SSL_CTX_set_options( m_ctx, SSL_OP_ENABLE_KTLS | SSL_OP_NO_RENEGOTIATION | SSL_OP_NO_COMPRESSION );
+    // TLS 1.3 tickets would be written after the handshake, when the records are the kernel's
+    SSL_CTX_set_num_tickets( m_ctx, 0 );
+    SSL_CTX_set_session_cache_mode( m_ctx, SSL_SESS_CACHE_OFF );
+
+    const char *failed = nullptr;
+    if( SSL_CTX_set_cipher_list( m_ctx, CIPHERS ) != 1 )
+    {
+        failed = "SSL_CTX_set_cipher_list";
+    }
+    else if( SSL_CTX_set_ciphersuites( m_ctx, CIPHERSUITES ) != 1 )
+    {
+        failed = "SSL_CTX_set_ciphersuites";
+    }
+    else if( SSL_CTX_use_certificate_chain_file( m_ctx, cert.c_str() ) != 1 )
+    {
+        failed = "certificate";
+    }
+    else if( SSL_CTX_use_PrivateKey_file( m_ctx, (key.empty() ? cert : key).c_str(), SSL_FILETYPE_PEM ) != 1 )
+    {
+        failed = "private key";
+    }
+    else if( SSL_CTX_check_private_key( m_ctx ) != 1 )
+    {
+        failed = "private key check";
+    }
+    if( failed )
+    {
+        TlsError err( failed );
+        SSL_CTX_free( m_ctx );
+        throw err;
+    }
+}
+
+rtsp::TlsContext::~TlsContext()
+{
+    SSL_CTX_free( m_ctx );
+}
+
+
+rtsp::TlsSession::TlsSession( const TlsContext &context, int fd )
+: m_ssl( SSL_new( context.get() ) )
+, m_in( BIO_new( BIO_s_mem() ) )
+{
+    BIO *out = BIO_new_socket( fd, BIO_NOCLOSE );
+    if( !m_ssl || !m_in || !out )
+    {
+        TlsError err( "SSL_new" );
+        BIO_free( out );
+        BIO_free( m_in );
+        SSL_free( m_ssl );
+        throw err;
+    }
+    // an empty memory BIO means "wait for more", not the end of the stream
+    BIO_set_mem_eof_return( m_in, -1 );
+    // reads from what the loop has received, writes straight to the socket: that is
+    // the BIO the transmit keys are installed on
+    SSL_set_bio( m_ssl, m_in, out );
+    SSL_set_accept_state( m_ssl );
+}
+
+rtsp::TlsSession::~TlsSession()
+{
+    // the BIOs go with it, the socket stays open (BIO_NOCLOSE)
+    SSL_free( m_ssl );
+}
+
+bool rtsp::TlsSession::receive( const uint8_t *data, size_t size, std::vector< uint8_t > &plain )
+{
+    if( !m_error.empty() )
+    {
+        return false;
+    }
+    ERR_clear_error();
+    if( size && BIO_write( m_in, data, size ) != int(size) )
+    {
+        m_error = "BIO_write failed: " + ssl_error();
+        return false;
+    }
+
+    if( !m_established )
+    {
+        int rc = SSL_do_handshake( m_ssl );
+        if( rc != 1 )
+        {
+            int err = SSL_get_error( m_ssl, rc );
+            if( err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE )
+            {
+                return true;
+            }
+            return f_fail( "handshake", rc );
+        }
+        if( !BIO_get_ktls_send( SSL_get_wbio( m_ssl ) ) )
+        {
+            // encrypting every frame in userspace for every client is what this is to avoid
+            m_error = "kernel TLS is not available for " + description() + " (modprobe tls)";
+            return false;
+        }
+        m_established = true;
+    }
+
+    size_t offset = plain.size();
+    while( true )
+    {
+        plain.resize( offset + READ_SIZE );
+        int rc = SSL_read( m_ssl, plain.data() + offset, READ_SIZE );
+        if( rc > 0 )
+        {
+            offset += rc;
+            continue;
+        }
+        plain.resize( offset );
+        int err = SSL_get_error( m_ssl, rc );
+        if( err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE )
+        {
+            return true;
+        }
+        if( err == SSL_ERROR_ZERO_RETURN )
+        {
+            m_error = "close_notify";
+            return false;
+        }
+        return f_fail( "SSL_read", rc );
+    }
+}
+
+std::string rtsp::TlsSession::description() const
+{
+    return std::string( SSL_get_version( m_ssl ) ) + " " + SSL_get_cipher_name( m_ssl );
+}
+
+bool rtsp::TlsSession::f_fail( const std::string &what, int rc )
+{
+    int err = SSL_get_error( m_ssl, rc );
+    m_error = what + " failed: " + (err == SSL_ERROR_SYSCALL && !ERR_peek_error() ? std::string( "connection reset" ) : ssl_error());
+    return false;
+}
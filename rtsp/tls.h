@@ -0,0 +1,81 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#ifndef RTSP_TLS_H
+#define RTSP_TLS_H
+
+#include <openssl/ssl.h>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace rtsp {
+
+    class TlsError: public std::runtime_error
+    {
+    public:
+        TlsError( const std::string &what );
+    };
+
+    // server certificate and TLS settings of a loop. Only AEAD ciphers the kernel TLS
+    // implementation takes, and OpenSSL hands the keys to the kernel (SSL_OP_ENABLE_KTLS)
+    class TlsContext {
+    public:
+        TlsContext( const std::string &cert, const std::string &key );
+        TlsContext(const TlsContext& orig) = delete;
+        TlsContext &operator =(const TlsContext& orig) = delete;
+        ~TlsContext();
+
+        SSL_CTX *get() const
+        {
+            return m_ctx;
+        }
+
+    private:
+        SSL_CTX *m_ctx;
+    };
+
+    // TLS of one rtsp connection. The handshake runs in userspace on the bytes the loop
+    // has read from the socket; OpenSSL writes to the socket itself and, once the handshake
+    // is over, installs the transmit keys into the kernel (TCP_ULP "tls"). From then on
+    // the connection writes plaintext with writev / io_uring and the kernel encrypts it.
+    // The client's records (requests, RTCP) are small and are decrypted here
+    class TlsSession {
+    public:
+        TlsSession( const TlsContext &context, int fd );
+        TlsSession(const TlsSession& orig) = delete;
+        TlsSession &operator =(const TlsSession& orig) = delete;
+        ~TlsSession();
+
+        // records read from the socket (none - just retry a handshake write that got EAGAIN):
+        // advances the handshake and appends the decrypted data to plain.
+        // false - the session is broken or the kernel can not take over the encryption
+        bool receive( const uint8_t *data, size_t size, std::vector< uint8_t > &plain );
+
+        // the handshake is over, everything written to the socket is encrypted by the kernel
+        bool established() const
+        {
+            return m_established;
+        }
+        const std::string &error() const
+        {
+            return m_error;
+        }
+        // protocol version and cipher
+        std::string description() const;
+
+    private:
+        SSL *m_ssl;
+        BIO *m_in;              // memory BIO with the records read by the loop
+        bool m_established {false};
+        std::string m_error;
+
+    private:
+        bool f_fail( const std::string &what, int rc );
+    };
+
+}  // namespace rtsp
+
+#endif /* RTSP_TLS_H */
@@ -0,0 +1,247 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#include "uring.h"
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+rtsp::UringError::UringError( const std::string &what, int error )
+: std::runtime_error( "[uring] " + what + " failed: " + strerror( error ) )
+{}
+
+
+rtsp::Uring::Uring( const Options &options, Stream &stream, size_t index )
+: Loop( options, stream, index )
+, m_buffer_data( new uint8_t[BUFFERS * BUFFER_SIZE] )
+{
+    io_uring_params params;
+    memset( &params, 0, sizeof(params) );
+    params.flags = IORING_SETUP_COOP_TASKRUN;
+    int rc = io_uring_queue_init_params( ENTRIES, &m_ring, &params );
+    if( rc == -EINVAL )
+    {
+        memset( &params, 0, sizeof(params) );
+        rc = io_uring_queue_init_params( ENTRIES, &m_ring, &params );
+    }
+    if( rc < 0 )
+    {
+        throw UringError( "io_uring_queue_init", -rc );
+    }
+
+    m_buffers = io_uring_setup_buf_ring( &m_ring, BUFFERS, BUFFER_GROUP, 0, &rc );
+    if( !m_buffers )
+    {
+        io_uring_queue_exit( &m_ring );
+        throw UringError( "io_uring_setup_buf_ring", -rc );
+    }
+    for( unsigned i = 0; i < BUFFERS; ++i )
+    {
+        io_uring_buf_ring_add( m_buffers, m_buffer_data.get() + i * BUFFER_SIZE, BUFFER_SIZE, i, io_uring_buf_ring_mask( BUFFERS ), i );
+    }
+    io_uring_buf_ring_advance( m_buffers, BUFFERS );
+    std::cerr << "[*] loop " << m_index << ": io_uring\n";
+}
+
+rtsp::Uring::~Uring()
+{
+    // the connections go away after the ring, nothing is written from their buffers anymore
+    io_uring_free_buf_ring( &m_ring, m_buffers, BUFFERS, BUFFER_GROUP );
+    io_uring_queue_exit( &m_ring );
+}
+
+void rtsp::Uring::run()
+{
+    f_pin();
+
+    io_uring_prep_multishot_accept( f_sqe( Accept, m_socket ), m_socket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC );
+    io_uring_prep_poll_multishot( f_sqe( Wakeup, m_stream.wakeup( m_index ) ), m_stream.wakeup( m_index ), POLLIN );
+    io_uring_prep_poll_multishot( f_sqe( Timer, m_timer_fd ), m_timer_fd, POLLIN );
+    if( m_rtcp )
+    {
+        io_uring_prep_poll_multishot( f_sqe( Rtcp, *m_rtcp ), *m_rtcp, POLLIN );
+    }
+
+    uint8_t buffer[0xffff];
+    while( m_running.load() )
+    {
+        // everything queued by the previous iteration goes to the kernel with this call
+        int rc = io_uring_submit_and_wait( &m_ring, 1 );
+        if( rc < 0 && rc != -EINTR && rc != -EBUSY )
+        {
+            std::cerr << "[uring] submit failed: " << strerror( -rc ) << std::endl;
+            break;
+        }
+
+        io_uring_cqe *cqe;
+        unsigned head;
+        unsigned count = 0;
+        io_uring_for_each_cqe( &m_ring, head, cqe )
+        {
+            f_complete( cqe, buffer, sizeof(buffer) );
+            ++count;
+        }
+        io_uring_cq_advance( &m_ring, count );
+
+        f_send_frames();
+        f_arm_timers();
+    }
+}
+
+void rtsp::Uring::write( Connection &conn, const msghdr &msg )
+{
+    io_uring_prep_sendmsg( f_sqe( Send, conn ), conn, &msg, MSG_NOSIGNAL );
+    ++m_inflight[conn];
+}
+
+io_uring_sqe *rtsp::Uring::f_sqe( Op op, int fd )
+{
+    io_uring_sqe *sqe = io_uring_get_sqe( &m_ring );
+    while( !sqe )
+    {
+        // the submission queue is full: hand it to the kernel right away
+        io_uring_submit( &m_ring );
+        sqe = io_uring_get_sqe( &m_ring );
+    }
+    io_uring_sqe_set_data64( sqe, (uint64_t(op) << 32) | uint32_t(fd) );
+    return sqe;
+}
+
+void rtsp::Uring::f_complete( const io_uring_cqe *cqe, uint8_t *buffer, size_t size )
+{
+    Op op = Op(cqe->user_data >> 32);
+    int fd = int(uint32_t(cqe->user_data));
+    bool more = cqe->flags & IORING_CQE_F_MORE;
+
+    switch( op )
+    {
+    case Accept:
+        if( cqe->res >= 0 )
+        {
+            sockaddr_in address;
+            socklen_t socklen = sizeof(address);
+            memset( &address, 0, sizeof(address) );
+            getpeername( cqe->res, (sockaddr *)&address, &socklen );
+            f_connect( cqe->res, address, this );
+
+            io_uring_sqe *sqe = f_sqe( Receive, cqe->res );
+            io_uring_prep_recv_multishot( sqe, cqe->res, nullptr, 0, 0 );
+            sqe->flags |= IOSQE_BUFFER_SELECT;
+            sqe->buf_group = BUFFER_GROUP;
+            ++m_inflight[cqe->res];
+        }
+        else if( cqe->res != -EINTR && cqe->res != -ECONNABORTED )
+        {
+            std::cerr << "error: accept failed: " << strerror( -cqe->res ) << std::endl;
+        }
+        if( !more )
+        {
+            io_uring_prep_multishot_accept( f_sqe( Accept, m_socket ), m_socket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC );
+        }
+        break;
+    case Wakeup:
+    {
+        uint64_t count;
+        while( ::read( fd, &count, sizeof(count) ) == -1 && errno == EINTR );
+        if( !more )
+        {
+            io_uring_prep_poll_multishot( f_sqe( Wakeup, fd ), fd, POLLIN );
+        }
+        break;
+    }
+    case Timer:
+        f_timers();
+        if( !more )
+        {
+            io_uring_prep_poll_multishot( f_sqe( Timer, fd ), fd, POLLIN );
+        }
+        break;
+    case Rtcp:
+        f_receive_rtcp( buffer, size );
+        if( !more )
+        {
+            io_uring_prep_poll_multishot( f_sqe( Rtcp, fd ), fd, POLLIN );
+        }
+        break;
+    case Receive:
+        f_receive( fd, cqe );
+        break;
+    case Send:
+    {
+        Sessions::Slot *slot = m_sessions.find( fd );
+        if( slot )
+        {
+            // may queue the next batch of the connection
+            slot->conn->on_written( cqe->res );
+        }
+        f_release( fd );
+        break;
+    }
+    }
+}
+
+void rtsp::Uring::f_receive( int fd, const io_uring_cqe *cqe )
+{
+    Sessions::Slot *slot = m_sessions.find( fd );
+    if( cqe->flags & IORING_CQE_F_BUFFER )
+    {
+        unsigned id = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        uint8_t *data = m_buffer_data.get() + id * BUFFER_SIZE;
+        if( cqe->res > 0 && slot )
+        {
+            f_received( *slot->conn, data, cqe->res );
+        }
+        // the buffer goes back to the kernel
+        io_uring_buf_ring_add( m_buffers, data, BUFFER_SIZE, id, io_uring_buf_ring_mask( BUFFERS ), 0 );
+        io_uring_buf_ring_advance( m_buffers, 1 );
+    }
+    if( cqe->flags & IORING_CQE_F_MORE )
+    {
+        return;
+    }
+
+    if( slot && (cqe->res > 0 || cqe->res == -ENOBUFS) )
+    {
+        // the multishot receive has stopped (no free buffers), the connection is fine
+        io_uring_sqe *sqe = f_sqe( Receive, fd );
+        io_uring_prep_recv_multishot( sqe, fd, nullptr, 0, 0 );
+        sqe->flags |= IOSQE_BUFFER_SELECT;
+        sqe->buf_group = BUFFER_GROUP;
+        return;
+    }
+    f_release( fd );
+    if( slot )
+    {
+        // the peer has closed the connection or it is broken
+        f_close( fd );
+    }
+}
+
+void rtsp::Uring::f_release( int fd )
+{
+    auto i = m_inflight.find( fd );
+    if( i == m_inflight.end() || --i->second > 0 )
+    {
+        return;
+    }
+    m_inflight.erase( i );
+    // the last request of a closed connection, the socket can be closed now
+    m_closing.erase( fd );
+}
+
+void rtsp::Uring::f_close( int fd )
+{
+    Sessions::Slot *slot = m_sessions.find( fd );
+    if( slot && m_inflight.count( fd ) )
+    {
+        // the requests in flight still use the socket and the connection's buffers:
+        // shutdown makes them complete, the connection is destroyed with the last one
+        m_closing[fd] = slot->conn;
+        shutdown( fd, SHUT_RDWR );
+    }
+    Loop::f_close( fd );
+}
@@ -0,0 +1,59 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#ifndef RTSP_URING_H
+#define RTSP_URING_H
+
+#include "loop.h"
+#include "connection.h"
+#include <liburing.h>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace rtsp {
+
+    class UringError: public std::runtime_error
+    {
+    public:
+        UringError( const std::string &what, int error );
+    };
+
+    // io_uring backend (Linux 6.0+): multishot accept, multishot receive into a ring of
+    // provided buffers, and the writes of all connections collected during an iteration
+    // go to the kernel with one submission
+    class Uring: public Loop, public AsyncWriter {
+    public:
+        static const unsigned ENTRIES = 1024;
+        static const unsigned BUFFERS = 256;        // provided receive buffers, a power of two
+        static const size_t BUFFER_SIZE = 4096;
+        static const int BUFFER_GROUP = 0;
+
+        Uring( const Options &options, Stream &stream, size_t index );
+        ~Uring() override;
+
+        void run() override;
+        void write( Connection &conn, const msghdr &msg ) override;
+
+    private:
+        enum Op : uint64_t { Accept = 1, Wakeup, Rtcp, Receive, Send, Timer };
+
+        io_uring m_ring;
+        io_uring_buf_ring *m_buffers {nullptr};
+        std::unique_ptr< uint8_t[] > m_buffer_data;
+        std::map< int, int > m_inflight;    // fd -> requests not completed yet
+        std::map< int, std::shared_ptr< Connection > > m_closing;   // closed connections waiting for their requests
+
+    private:
+        io_uring_sqe *f_sqe( Op op, int fd );
+        void f_complete( const io_uring_cqe *cqe, uint8_t *buffer, size_t size );
+        void f_receive( int fd, const io_uring_cqe *cqe );
+        void f_release( int fd );
+        void f_close( int fd ) override;
+    };
+
+}  // namespace rtsp
+
+#endif /* RTSP_URING_H */
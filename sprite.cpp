@@ -0,0 +1,41 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#include "sprite.h"
+#include <algorithm>
+
+void Sprite::reset( const std::string &key, cv::Size size )
+{
+    m_key = key;
+    m_image.create( size.height, size.width, CV_8UC3 );
+    m_alpha.create( size.height, size.width, CV_8UC1 );
+    m_image.setTo( cv::Scalar::all( 0 ) );
+    m_alpha.setTo( cv::Scalar::all( 0 ) );
+}
+
+void Sprite::blend( cv::Mat &dst, cv::Point at, double opacity ) const
+{
+    int x0 = std::max( 0, -at.x ), y0 = std::max( 0, -at.y );
+    int x1 = std::min( m_image.cols, dst.cols - at.x ), y1 = std::min( m_image.rows, dst.rows - at.y );
+    int weight = int(opacity * 256. + .5);
+    for( int y = y0; y < y1; ++y )
+    {
+        const uchar *src = m_image.ptr( y );
+        const uchar *alpha = m_alpha.ptr( y );
+        uchar *out = dst.ptr( at.y + y ) + 3 * at.x;
+        for( int x = x0; x < x1; ++x )
+        {
+            // text is mostly transparent: only the covered pixels are touched
+            if( !alpha[x] )
+            {
+                continue;
+            }
+            int a = alpha[x] * weight >> 8;
+            for( int c = 0; c < 3; ++c )
+            {
+                out[3 * x + c] = uchar((out[3 * x + c] * (255 - a) + src[3 * x + c] * a) / 255);
+            }
+        }
+    }
+}
@@ -0,0 +1,47 @@
+//
+// Created by mkh on 19.10.2026.
+//
+
+#ifndef VIDEODEFECTS_SPRITE_H
+#define VIDEODEFECTS_SPRITE_H
+
+#include <opencv2/core/mat.hpp>
+#include <string>
+
+// An overlay of the preview (text, a histogram) rasterized once into its own small canvas and
+// blended into every preview frame until its content changes. The shapes are drawn twice:
+// in color into image() and with 255 into alpha(), the coverage the blending uses
+class Sprite {
+public:
+    // the content the sprite was drawn for is not the same as key
+    bool stale( const std::string &key ) const
+    {
+        return m_image.empty() || key != m_key;
+    }
+    // a cleared canvas of that size for the new content, the buffers are kept between redraws
+    void reset( const std::string &key, cv::Size size );
+
+    cv::Mat &image()
+    {
+        return m_image;
+    }
+    cv::Mat &alpha()
+    {
+        return m_alpha;
+    }
+    cv::Size size() const
+    {
+        return cv::Size( m_image.cols, m_image.rows );
+    }
+
+    // blends the sprite with its top left corner at `at`, clipped to dst; opacity 0..1
+    void blend( cv::Mat &dst, cv::Point at, double opacity = 1. ) const;
+
+private:
+    std::string m_key;
+    cv::Mat m_image;    // CV_8UC3
+    cv::Mat m_alpha;    // CV_8UC1
+};
+
+
+#endif //VIDEODEFECTS_SPRITE_H
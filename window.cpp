@@ -3,10 +3,14 @@
 //
 
 #include "window.h"
+#include "governor.h"
 #include "rtsp/service.h"
 
+#include <opencv2/imgproc.hpp>
+#include <poll.h>
 #include <signal.h>
 #include <sys/time.h>
+#include <chrono>
 
 namespace {
     bool running = true;
@@ -23,41 +27,114 @@ namespace {
     }
 }  // namespace
 
-Window::Window( char const *name )
+Window::Window( char const *name, const Options &options )
 : m_name( name )
+, m_options( options )
 {
     signal( SIGHUP,  signal_handler );
     signal( SIGTERM, signal_handler );
     signal( SIGSEGV, signal_handler);
     signal( SIGINT,  signal_handler);
 
-    cv::namedWindow( name, cv::WINDOW_AUTOSIZE );
+    if( !m_options.control.empty() )
+    {
+        m_control.reset( new Control( m_options.control ) );
+    }
+    if( !m_options.headless )
+    {
+        cv::namedWindow( name, cv::WINDOW_AUTOSIZE );
+    }
 }
 
 Window::~Window()
 {
-    cv::destroyAllWindows();
+    if( !m_options.headless )
+    {
+        cv::destroyAllWindows();
+    }
 }
 
 void Window::run( Reader &r )
 {
-    std::unique_ptr< rtsp::Service > srv( new rtsp::Service( 5555, r.fps() ) );
+    using clock = std::chrono::steady_clock;
+
+    std::unique_ptr< Governor > gov( m_options.governor ? new Governor( r.fps() ) : nullptr );
+    std::unique_ptr< rtsp::Service > srv( new rtsp::Service( m_options, r.fps(), gov.get() ) );
 
     cv::Mat frame;
+    double scale = 1.;
 
     int delta = 0;
+    clock::time_point next = clock::now();     // the headless pacer's deadline
+    clock::time_point next_preview = next;
     while( running ) {
+        auto t0 = clock::now();
+        // the previous frame may still be waiting for the encoder: decode into a new buffer
+        frame.release();
         r.read( frame, &delta );
         if( frame.empty() ) {
             r.reopen();
             continue;
         }
         uint64_t ts = now();
+        auto t1 = clock::now();
 
-        srv->store( m_defects.convert( frame ).clone(), delta );
+        cv::Mat converted = m_defects.convert( frame );
+        if( scale < 1. )
+        {
+            // the encoders need even dimensions
+            cv::Mat scaled;
+            cv::resize( converted, scaled, cv::Size( int(converted.cols * scale) & ~1, int(converted.rows * scale) & ~1 ), 0, 0, cv::INTER_AREA );
+            srv->store( scaled, delta );
+        }
+        else
+        {
+            // shared with the stream, not copied
+            srv->store( converted, delta );
+        }
+        auto t2 = clock::now();
 
-        cv::imshow( m_name.c_str(), m_defects.testList( m_defects.histogram( m_defects.result( frame ) ) ) );
+        if( !m_options.headless && t2 >= next_preview )
+        {
+            // at most preview_fps, the window keeps the last preview in between
+            if( m_options.preview_fps > 0 )
+            {
+                auto interval = std::chrono::duration_cast< clock::duration >( std::chrono::duration< double >( 1. / m_options.preview_fps ) );
+                next_preview = next_preview + interval < t2 ? t2 + interval : next_preview + interval;
+            }
+            f_preview( converted, scale >= 1. );
+        }
+        auto t3 = clock::now();
+
+        if( gov )
+        {
+            gov->report( Governor::Read, t1 - t0 );
+            gov->report( Governor::Defects, t2 - t1 );
+            gov->report( Governor::Preview, t3 - t2 );
+            if( gov->update() )
+            {
+                m_defects.metrics_interval( gov->level().metrics_interval );
+                scale = gov->level().scale;
+            }
+        }
 
+        if( m_options.headless )
+        {
+            // the frame interval from the previous deadline, not from now: no drift; more than a
+            // frame late (a stall of the source) - start over instead of catching up in a burst
+            next += std::chrono::milliseconds( delta );
+            if( next + std::chrono::milliseconds( delta ) < clock::now() )
+            {
+                next = clock::now();
+            }
+            f_wait( next );
+            continue;
+        }
+
+        if( m_control )
+        {
+            m_control->process( m_defects );
+        }
         int passed = 0;
         do {
             passed = now() - ts;
@@ -73,6 +150,41 @@ void Window::run( Reader &r )
     }
 }
 
+void Window::f_preview( cv::Mat &converted, bool shared )
+{
+    cv::Mat preview = converted;
+    if( m_options.preview_width && converted.cols > m_options.preview_width )
+    {
+        // a 4K source is shown and drawn on at the preview size
+        int height = converted.rows * m_options.preview_width / converted.cols;
+        cv::resize( converted, m_preview, cv::Size( m_options.preview_width, height ), 0, 0, cv::INTER_AREA );
+        preview = m_preview;
+    }
+    else if( shared )
+    {
+        // the overlays go onto the preview's own layer, never onto the pixels being encoded
+        converted.copyTo( m_preview );
+        preview = m_preview;
+    }
+    cv::imshow( m_name.c_str(), m_defects.testList( m_defects.histogram( m_defects.result( preview ) ) ) );
+}
+
+void Window::f_wait( std::chrono::steady_clock::time_point deadline )
+{
+    using clock = std::chrono::steady_clock;
+
+    pollfd pfd { m_control ? m_control->fd() : -1, POLLIN, 0 };
+    for( auto t = clock::now(); running && t < deadline; t = clock::now() )
+    {
+        auto left = std::chrono::duration_cast< std::chrono::nanoseconds >( deadline - t ).count();
+        timespec timeout { time_t(left / 1000000000), long(left % 1000000000) };
+        if( ppoll( &pfd, 1, &timeout, nullptr ) > 0 )
+        {
+            m_control->process( m_defects );
+        }
+    }
+}
+
 void Window::f_manage_keycode( int code )
 {
     m_defects.highlight( false );;
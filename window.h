@@ -7,22 +7,36 @@
 
 
 #include "reader.h"
+#include "control.h"
 #include "defects.h"
+#include "options.h"
+#include <chrono>
+#include <memory>
 #include <string>
 
+// The pipeline: reader -> defects -> stream, with the preview window and its keys, or
+// headless (options.headless) - no HighGUI calls at all, paced by the monotonic clock and
+// controlled through the control channel only
 class Window {
 public:
-    Window( char const *name );
+    Window( char const *name, const Options &options );
     ~Window();
 
     void run( Reader &r );
 
 private:
     std::string m_name;
+    Options m_options;
     Defects m_defects;
+    cv::Mat m_preview;      // the frame with the overlays, the stream never sees it
+    std::unique_ptr< Control > m_control;
 
 private:
     void f_manage_keycode( int code );
+    // shared - the converted frame is being encoded as it is and is not drawn on
+    void f_preview( cv::Mat &converted, bool shared );
+    // sleeps until the deadline, serving the control channel meanwhile
+    void f_wait( std::chrono::steady_clock::time_point deadline );
 };
 
 